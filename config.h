@@ -2,6 +2,7 @@
 #define CONFIG_UNICODE
 #define CONFIG_MULTITHREAD
 #define CONFIG_MSVCRT
+//#define CONFIG_ALLOC_STATS
 
 //-----------
 // failsafes
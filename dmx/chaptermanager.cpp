@@ -1,10 +1,41 @@
 #include "chaptermanager.h"
 #include "utilities.h"
+#include "xmlwriter.h"
+#include "ebmlwriter.h"
 
-#include <QtXml>
+#include <vector>
+#include <QFile>
+#include <QScopedPointer>
 
 QString ChapterManager::INFO_SUFFIX ("_info.xml");
 QString ChapterManager::CHAPTER_SUFFIX ("_menu.xml");
+QString ChapterManager::EBML_INFO_SUFFIX ("_info.ebml");
+QString ChapterManager::EBML_CHAPTER_SUFFIX ("_menu.ebml");
+
+QString ChapterManager::chapterSuffix() const
+{
+	return (format_ == FORMAT_EBML) ? EBML_CHAPTER_SUFFIX : CHAPTER_SUFFIX;
+}
+
+QString ChapterManager::infoSuffix() const
+{
+	return (format_ == FORMAT_EBML) ? EBML_INFO_SUFFIX : INFO_SUFFIX;
+}
+
+DocumentWriter* ChapterManager::createWriter(QFile& file) const
+{
+	// the binary output must not get its line ends converted
+	if (format_ == FORMAT_EBML)
+	{
+		if (!file.open(QIODevice::WriteOnly))
+			throw;
+		return new EbmlWriter(&file);
+	}
+
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+		throw;
+	return new XmlWriter(&file, INDENT_COUNT);
+}
 
 bool ChapterManager::generateScript(const IFOFile& ifoFile, const QString& filename, uint16_t title, const QString& editionUID) const
 {
@@ -12,56 +43,55 @@ bool ChapterManager::generateScript(const IFOFile& ifoFile, const QString& filen
 	static unsigned char _PrivateTT[]  = {0x28, 0x00, 0x00, 0x00};
     uint64_t start_timeH = uint64_t(-1); // TODO use another invalid value
 
-	generateInfoScript(filename, title, editionUID);
+	generateInfoScript(ifoFile, filename, title, editionUID);
 
-	// create document
-	QDomDocument document;
+	// chapter file
+	QFile chapterFile (filename + chapterSuffix());
+	QScopedPointer<DocumentWriter> output (createWriter(chapterFile));
+	DocumentWriter& writer = *output;
 
 	// specify processing info
-	document.appendChild(document.createProcessingInstruction("xml", "version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\""));
-	document.appendChild(document.implementation().createDocumentType("Chapters", QString::null, "matroskachapters.dtd"));
+	writer.writeStartDocument("Chapters", "matroskachapters.dtd");
 
 	// create comments
-	document.appendChild(document.createComment("Created with " + Utilities::APPLICATION_NAME + " " + Utilities::APPLICATION_VERSION));
+	writer.writeComment("Created with " + Utilities::APPLICATION_NAME + " " + Utilities::APPLICATION_VERSION);
 
 	// create the root element
-	QDomNode root = document.createElement("Chapters");
-	document.appendChild(root);
+	writer.writeStartElement("Chapters");
 
 	// VTS content
-	QDomElement editionEntryElement = document.createElement("EditionEntry");
-	root.appendChild(editionEntryElement);
+	writer.writeStartElement("EditionEntry");
 	
-	editionEntryElement.appendChild(CreateDOMElement(document, "EditionUID", editionUID));
-	editionEntryElement.appendChild(CreateDOMElement(document, "EditionFlagOrdered", "1"));
-	editionEntryElement.appendChild(document.createComment("Video Title Set"));
+	writer.writeTextElement("EditionUID", editionUID);
+	writer.writeTextElement("EditionFlagOrdered", "1");
+	writer.writeComment("Video Title Set");
 
-	QDomElement chapterAtomElement = document.createElement("ChapterAtom");
-	editionEntryElement.appendChild(chapterAtomElement);
+	writer.writeStartElement("ChapterAtom");
 
 	QString _myUIDa = Utilities::CreateUID();
-	chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterUID", _myUIDa));
-	chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterFlagHidden", "1"));
+	writer.writeTextElement("ChapterUID", _myUIDa);
+	writer.writeTextElement("ChapterFlagHidden", "1");
 	
 	_PrivateVTS[2] = title >> 8;
 	_PrivateVTS[3] = title & 0xFF;
-	AddCodecPrivateData(document, chapterAtomElement, _PrivateVTS, 4);
-
-	QDomNode chapterAtomParentElement = chapterAtomElement;
+	AddCodecPrivateData(writer, _PrivateVTS, 4);
 
 	if (ifoFile.VtsTitles(title) && ifoFile.VtsPGCs(title))
 	{
 		for (int i = 0; i < ifoFile.VtsTitles(title)->nr_of_srpts; i++)
 		{
 			uint64_t start_time = uint64_t(-1), found_time;
+
+			// none of the PGCs of this title was selected
+			if (IsPGCSkipped(ifoFile.VtsPGCs(title), -1, i+1, ifoFile.CellsList(title, false)))
+				continue;
 			
-			chapterAtomParentElement.appendChild(document.createComment(QString("Title TTU_%1").arg(i + 1)));
-			QDomElement chapterAtomElement = document.createElement("ChapterAtom");
-			chapterAtomParentElement.appendChild(chapterAtomElement);
+			writer.writeComment(QString("Title TTU_%1").arg(i + 1));
+			writer.writeStartElement("ChapterAtom");
 			
 			QString _myUIDa = Utilities::CreateUID();
-			chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterUID", _myUIDa));
-			chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterFlagHidden", "1"));
+			writer.writeTextElement("ChapterUID", _myUIDa);
+			writer.writeTextElement("ChapterFlagHidden", "1");
 
 			// get the Title -> VTS+TTN map
 			const tt_srpt_t *p_map = ifoFile.TitleMap();
@@ -75,7 +105,7 @@ bool ChapterManager::generateScript(const IFOFile& ifoFile, const QString& filen
 						_PrivateTT[1] = (j+1) >> 8;   // Title#
 						_PrivateTT[2] = (j+1) & 0xFF;
 						_PrivateTT[3] = i+1;          // VTS_TTN#
-						AddCodecPrivateData(document, chapterAtomElement, _PrivateTT, 4);
+						AddCodecPrivateData(writer, _PrivateTT, 4);
 						break;
 					}
 				}
@@ -84,9 +114,9 @@ bool ChapterManager::generateScript(const IFOFile& ifoFile, const QString& filen
 			// add the PGC that match this PTT
 			for (int k = 0; k < ifoFile.VtsPGCs(title)->nr_of_pgci_srp; k++)
 			{
-				if ((ifoFile.VtsPGCs(title)->pgci_srp[k].entry_id & 0x7F) == i+1)
+				if ((ifoFile.VtsPGCs(title)->pgci_srp[k].entry_id & 0x7F) == i+1 && !IsPGCSkipped(ifoFile.VtsPGCs(title), k, 0, ifoFile.CellsList(title, false)))
 				{
-					found_time = AddPGC(document, chapterAtomElement, 
+					found_time = AddPGC(writer, 
 						ifoFile.VtsPGCs(title)->pgci_srp[k].pgc, k, 0, ifoFile.CellsList(title, false), &ifoFile.VtsTitles(title)->title[i], i+1);
 					
 					if (start_time > found_time)
@@ -94,7 +124,8 @@ bool ChapterManager::generateScript(const IFOFile& ifoFile, const QString& filen
 				}
 			}
 
-			chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterTimeStart", Utilities::FormatTime(start_time)));
+			writer.writeTextElement("ChapterTimeStart", Utilities::FormatTime(start_time));
+			writer.writeEndElement();
 
 			if (start_timeH > start_time)
 				start_timeH = start_time;
@@ -104,19 +135,11 @@ bool ChapterManager::generateScript(const IFOFile& ifoFile, const QString& filen
 	if (start_timeH == uint64_t(-1))
 		start_timeH = 0;
 
-	chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterTimeStart", Utilities::FormatTime(start_timeH)));
-	
-	QString output = document.toString(INDENT_COUNT);
-
-	// TODO: not a good approach
-	output.replace("-->", "-->\n");
+	writer.writeTextElement("ChapterTimeStart", Utilities::FormatTime(start_timeH));
 
-	// chapter file
-	QFile chapterFile (filename + CHAPTER_SUFFIX);
-	if (!chapterFile.open(QIODevice::WriteOnly | QIODevice::Text))
-		throw;
+	if (!writer.writeEndDocument())
+		fprintf(stderr, "Could not write the chapter file '%s'\n", qPrintable(chapterFile.fileName()));
 
-	chapterFile.write(output.toUtf8());
 	chapterFile.close();
 
 	return true;
@@ -129,65 +152,62 @@ bool ChapterManager::generateMenuScript(const IFOFile& ifoFile, const QString& f
 	static unsigned char _PrivateVTS[] = {0x30, 0x40, 0x00, 0x00};
 
 	// generate info script
-	generateInfoScript(filename, title, editionUID);
+	generateInfoScript(ifoFile, filename, title, editionUID);
 
-	// create document
-	QDomDocument document;
+	// chapter file
+	QFile chapterFile(filename + chapterSuffix());
+	QScopedPointer<DocumentWriter> output (createWriter(chapterFile));
+	DocumentWriter& writer = *output;
 
 	// specify processing info
-	document.appendChild(document.createProcessingInstruction("xml", "version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\""));
-	document.appendChild(document.implementation().createDocumentType("Chapters", QString::null, "matroskachapters.dtd"));
+	writer.writeStartDocument("Chapters", "matroskachapters.dtd");
 
 	// create comments
-	document.appendChild(document.createComment("Created with " + Utilities::APPLICATION_NAME + " " + Utilities::APPLICATION_VERSION));
+	writer.writeComment("Created with " + Utilities::APPLICATION_NAME + " " + Utilities::APPLICATION_VERSION);
 
 	// create the root element
-	QDomNode parentElement = document.createElement("Chapters");
-	document.appendChild(parentElement);
+	writer.writeStartElement("Chapters");
 
-	// create Edition Entry Element and add to root
-	QDomElement currentElement = document.createElement("EditionEntry");
-	parentElement.appendChild(currentElement);
-	
-	// use Edition Entry Element as parent
-	parentElement = currentElement;
+	// create Edition Entry Element in the root
+	writer.writeStartElement("EditionEntry");
 
 	// add EditionUID and EDitionFlagOrdered elements
-	parentElement.appendChild(CreateDOMElement(document, "EditionUID", editionUID));
-	parentElement.appendChild(CreateDOMElement(document, "EditionFlagOrdered", "1"));
+	writer.writeTextElement("EditionUID", editionUID);
+	writer.writeTextElement("EditionFlagOrdered", "1");
 
 	// Write the first play PGC
 	if (title == 0 && ifoFile.FirstPlayPGC())
 	{
 		// add comment to Edition Entry Element
-		parentElement.appendChild(document.createComment("First Play PGC"));
+		writer.writeComment("First Play PGC");
 
 		// add Chapter Atom
-		QDomElement chapterAtomElement = document.createElement("ChapterAtom");
-		parentElement.appendChild(chapterAtomElement);
+		writer.writeStartElement("ChapterAtom");
 
 		// create and set UID
 		QString _myUID = Utilities::CreateUID();
-		chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterUID", _myUID));
+		writer.writeTextElement("ChapterUID", _myUID);
 
 		// the First Play PGC has no cell and no time
-		AddChapterTime(document, chapterAtomElement, 0, 0);
+		AddChapterTime(writer, 0, 0);
 
 		// display the UID for the lazy rippers
-		chapterAtomElement.appendChild(document.createComment("Enter your text here"));
+		writer.writeComment("Enter your text here");
 
 		// add Chapter Display Element
-		currentElement = document.createElement("ChapterDisplay");
-		currentElement.appendChild(CreateDOMElement(document, "ChapterString", "First Play PGC " + _myUID));
-		chapterAtomElement.appendChild(currentElement);
+		writer.writeStartElement("ChapterDisplay");
+		writer.writeTextElement("ChapterString", "First Play PGC " + _myUID);
+		writer.writeEndElement();
 
 		// add Chapter Process Element
-		currentElement = document.createElement("ChapterProcess");
-		AddCodecPrivateData(document, currentElement, _PrivateFP, 4, false);
-		chapterAtomElement.appendChild(currentElement);
+		writer.writeStartElement("ChapterProcess");
+		AddCodecPrivateData(writer, _PrivateFP, 4, false);
 
 		// PGC commands
-		AddPGCCommands(document, currentElement, ifoFile.FirstPlayPGC()->command_tbl);
+		AddPGCCommands(writer, ifoFile.FirstPlayPGC()->command_tbl);
+		writer.writeEndElement();
+
+		writer.writeEndElement();
 	}
 
 	// Write the Video Title Set
@@ -195,236 +215,165 @@ bool ChapterManager::generateMenuScript(const IFOFile& ifoFile, const QString& f
 	{
 		// VTS Menu
 		if ( title == 0 )
-			parentElement.appendChild(document.createComment("Video Manager"));
+			writer.writeComment("Video Manager");
 		else
-			parentElement.appendChild(document.createComment("Video Title Set"));
+			writer.writeComment("Video Title Set");
 
 		// add another Chapter Atom element
-		currentElement = document.createElement("ChapterAtom");
-		parentElement.appendChild(currentElement);
+		writer.writeStartElement("ChapterAtom");
 
 		QString _myUIDa = Utilities::CreateUID();
-		currentElement.appendChild(CreateDOMElement(document, "ChapterUID", _myUIDa));
-		currentElement.appendChild(CreateDOMElement(document, "ChapterFlagHidden", "1"));
+		writer.writeTextElement("ChapterUID", _myUIDa);
+		writer.writeTextElement("ChapterFlagHidden", "1");
 
 		if ( title != 0 )
 		{
 			_PrivateVTS[2] = title >> 8;
 			_PrivateVTS[3] = title & 0xFF;
-			AddCodecPrivateData(document, currentElement, _PrivateVTS, 4);
+			AddCodecPrivateData(writer, _PrivateVTS, 4);
 		}
 		else
 		{
 			_PrivateVM[2] = 0;
 			_PrivateVM[3] = 0;
-			AddCodecPrivateData(document, currentElement, _PrivateVM, 4);
+			AddCodecPrivateData(writer, _PrivateVM, 4);
 		}
 
-		uint64_t start_time = HandleLanguageUnit(document, currentElement, ifoFile, title);
+		uint64_t start_time = HandleLanguageUnit(writer, ifoFile, title);
 
-		currentElement.appendChild(CreateDOMElement(document, "ChapterTimeStart", Utilities::FormatTime(start_time)));
+		writer.writeTextElement("ChapterTimeStart", Utilities::FormatTime(start_time));
+		writer.writeEndElement();
 	}
 
-	// get document string representation
-	QString output = document.toString(INDENT_COUNT);
-
-	// TODO: not a good approach
-	output.replace("-->", "-->\n");
+	// close the elements and write to the chapter file
+	if (!writer.writeEndDocument())
+		fprintf(stderr, "Could not write the chapter file '%s'\n", qPrintable(chapterFile.fileName()));
 
-	// chapter file
-	QFile chapterFile(filename + CHAPTER_SUFFIX);
-	if (!chapterFile.open(QIODevice::WriteOnly | QIODevice::Text))
-		throw;
-	
-	// write to the chpater file
-	chapterFile.write(output.toUtf8());
 	chapterFile.close();
 
 	return true;
 }
 
-void ChapterManager::generateInfoScript(const QString &filename, uint16_t title, const QString &editionUID) const
+void ChapterManager::generateInfoScript(const IFOFile& ifoFile, const QString &filename, uint16_t title, const QString &editionUID) const
 {
-	// create document
-	QDomDocument document;
+	// segment file
+	QFile segementFile(filename + infoSuffix());
+	QScopedPointer<DocumentWriter> output (createWriter(segementFile));
+	DocumentWriter& writer = *output;
 
 	// specify xml version, encoding and DocType
-	document.appendChild(document.createProcessingInstruction("xml", "version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\""));
-	document.appendChild(document.implementation().createDocumentType("Chapters", QString::null, "matroskainfos.dtd"));
+	writer.writeStartDocument("Chapters", "matroskainfos.dtd");
 
 	// add root element
-	QDomNode parentElement = document.createElement("Info");
-	document.appendChild(parentElement);
+	writer.writeStartElement("Info");
 
 	// add Segment Family Element
-	QDomElement currentElement = CreateDOMElement(document, "SegmentFamily", Utilities::EncodeHex(familyUID, 16));
-	currentElement.setAttribute("format", "hex");
-	parentElement.appendChild(currentElement);
+	// all the titles of a disc belong to the same family, its ID is 16 bytes like the disc ID
+	uint8_t familyUID[16] = {0};
+	const QByteArray discID = ifoFile.DiscID();
+	if (discID.size() == sizeof(familyUID))
+		memcpy(familyUID, discID.constData(), sizeof(familyUID));
+
+	writer.writeTextElement("SegmentFamily", Utilities::EncodeHex(familyUID, 16), "format", "hex");
 
 	// add Chapter Translate Element
-	currentElement = document.createElement("ChapterTranslate");
-	currentElement.appendChild(CreateDOMElement(document, "ChapterTranslateEditionUID", editionUID));
-	currentElement.appendChild(CreateDOMElement(document, "ChapterTranslateCodec", "1"));
-	
-	QDomElement chapterTranslateIDElement = CreateDOMElement(document, "ChapterTranslateID", QString("%1 00").arg(title, 2, 16, QChar('0')));
-	chapterTranslateIDElement.setAttribute("format", "hex");
-	currentElement.appendChild(chapterTranslateIDElement);
+	writer.writeStartElement("ChapterTranslate");
+	writer.writeTextElement("ChapterTranslateEditionUID", editionUID);
+	writer.writeTextElement("ChapterTranslateCodec", "1");
+	writer.writeTextElement("ChapterTranslateID", QString("%1 00").arg(title, 2, 16, QChar('0')), "format", "hex");
+	writer.writeEndElement();
 
-	parentElement.appendChild(currentElement);
+	if (!writer.writeEndDocument())
+		fprintf(stderr, "Could not write the segment info file '%s'\n", qPrintable(segementFile.fileName()));
 
-	// get document string representation
-	QString output = document.toString(INDENT_COUNT);
-	
-	// segment file
-	QFile segementFile(filename + INFO_SUFFIX);
-	if (!segementFile.open(QIODevice::WriteOnly | QIODevice::Text))
-		throw;
-	
-	segementFile.write(output.toUtf8());
 	segementFile.close();
 }
 
-QDomElement ChapterManager::CreateDOMElement(QDomDocument &document, const QString &elementName, const QString &content)
+void ChapterManager::AddChapterTime(DocumentWriter& writer, uint64_t start_time, uint64_t end_time)
 {
-	QDomElement element = document.createElement(elementName);
-	element.appendChild(document.createTextNode(content));
-
-	return element;
+	writer.writeTextElement("ChapterTimeStart", Utilities::FormatTime(start_time));
+	writer.writeTextElement("ChapterTimeEnd", Utilities::FormatTime(end_time));
 }
 
-void ChapterManager::AddChapterTime(QDomDocument& document, QDomNode& parent, uint64_t start_time, uint64_t end_time)
+void ChapterManager::AddCodecPrivateData(DocumentWriter& writer, const unsigned char *buffer, unsigned int size, bool createChapterProcessElement /*= true*/)
 {
-	parent.appendChild(CreateDOMElement(document, "ChapterTimeStart", Utilities::FormatTime(start_time)));
-	parent.appendChild(CreateDOMElement(document, "ChapterTimeEnd", Utilities::FormatTime(end_time)));
+	if (createChapterProcessElement)
+		writer.writeStartElement("ChapterProcess");
+
+	writer.writeTextElement("ChapterProcessCodecID", "1");
+	writer.writeTextElement("ChapterProcessPrivate", Utilities::EncodeHex(buffer, size), "format", "hex");
+
+	if (createChapterProcessElement)
+		writer.writeEndElement();
 }
 
-void ChapterManager::AddCodecPrivateData(QDomDocument& document, QDomNode& parent, const unsigned char *buffer, unsigned int size, bool createChapterProcessElement /*= true*/)
+void ChapterManager::AddPGCCommand(DocumentWriter& writer, const QString& comment, const QString& time, uint8_t count, const vm_cmd_t *commands)
 {
-	QDomNode node = parent;
+	writer.writeComment(comment);
 
-	if (createChapterProcessElement)
-	{
-		QDomElement chapterProcessElement = document.createElement("ChapterProcess");
-		parent.appendChild(chapterProcessElement);
-		node = chapterProcessElement;
-	}
+	writer.writeStartElement("ChapterProcessCommand");
+	writer.writeTextElement("ChapterProcessTime", time);
 
-	node.appendChild(CreateDOMElement(document, "ChapterProcessCodecID", "1"));
+	// number of commands followed by the commands
+	std::vector<unsigned char> _buf(1 + count * 8);
+	_buf[0] = count;
+	memcpy(&_buf[1], commands, count * 8);
 
-	QDomElement chapterProcessPrivateElement = CreateDOMElement(document, "ChapterProcessPrivate", Utilities::EncodeHex(buffer, size));
-	chapterProcessPrivateElement.setAttribute("format", "hex");
-	node.appendChild(chapterProcessPrivateElement);
+	writer.writeTextElement("ChapterProcessData", Utilities::EncodeHex(&_buf[0], _buf.size()), "format", "hex");
+	writer.writeEndElement();
 }
 
-void ChapterManager::AddPGCCommands(QDomDocument& document, QDomNode& parent, const pgc_command_tbl_t * command_tbl)
+void ChapterManager::AddPGCCommands(DocumentWriter& writer, const pgc_command_tbl_t * command_tbl)
 {
 	if (command_tbl)
 	{
-		unsigned char *_buf = (unsigned char*) malloc(1 + command_tbl->nr_of_pre * 8);
-
 		// Pre-commands
 		if (command_tbl->nr_of_pre)
-		{
-			parent.appendChild(document.createComment("Pre commands"));
-
-			QDomElement chapterCommandElement = document.createElement("ChapterProcessCommand");
-			parent.appendChild(chapterCommandElement);
-
-			QDomElement chapterProcessTimeElement = document.createElement("ChapterProcessTime");
-			chapterProcessTimeElement.appendChild(document.createTextNode("1"));
-			chapterCommandElement.appendChild(chapterProcessTimeElement);
-
-			_buf[0] = command_tbl->nr_of_pre;
-			memcpy(&_buf[1], command_tbl->pre_cmds, command_tbl->nr_of_pre * 8);
-
-			QDomElement chapterProcessDataElement = CreateDOMElement(document, "ChapterProcessData", Utilities::EncodeHex(_buf, 1 + command_tbl->nr_of_pre * 8));
-			chapterProcessDataElement.setAttribute("format", "hex");
-			chapterCommandElement.appendChild(chapterProcessDataElement);
-		}
+			AddPGCCommand(writer, "Pre commands", "1", command_tbl->nr_of_pre, command_tbl->pre_cmds);
 
 		// Cell commands
 		if (command_tbl->nr_of_cell)
-		{
-			parent.appendChild(document.createComment("Cell commands"));
-
-			QDomElement chapterCommandElement = document.createElement("ChapterProcessCommand");
-			parent.appendChild(chapterCommandElement);
-
-			QDomElement chapterProcessTimeElement = document.createElement("ChapterProcessTime");
-			chapterProcessTimeElement.appendChild(document.createTextNode("0"));
-			chapterCommandElement.appendChild(chapterProcessTimeElement);
-
-			_buf = (unsigned char*) realloc(_buf, 1 + command_tbl->nr_of_cell * 8);
-			_buf[0] = command_tbl->nr_of_cell;
-			memcpy(&_buf[1], command_tbl->cell_cmds, command_tbl->nr_of_cell * 8);
-
-			QDomElement chapterProcessDataElement = CreateDOMElement(document, "ChapterProcessData", Utilities::EncodeHex(_buf, 1 + command_tbl->nr_of_cell * 8));
-			chapterProcessDataElement.setAttribute("format", "hex");
-			chapterCommandElement.appendChild(chapterProcessDataElement);
-		}
+			AddPGCCommand(writer, "Cell commands", "0", command_tbl->nr_of_cell, command_tbl->cell_cmds);
 
 		// Post commands
 		if (command_tbl->nr_of_post)
-		{
-			parent.appendChild(document.createComment("Post commands"));
-
-			QDomElement chapterCommandElement = document.createElement("ChapterProcessCommand");
-			parent.appendChild(chapterCommandElement);
-
-			QDomElement chapterProcessTimeElement = document.createElement("ChapterProcessTime");
-			chapterProcessTimeElement.appendChild(document.createTextNode("2"));
-			chapterCommandElement.appendChild(chapterProcessTimeElement);
-
-			_buf = (unsigned char*) realloc(_buf, 1+command_tbl->nr_of_post * 8);
-			_buf[0] = command_tbl->nr_of_post;
-			memcpy(&_buf[1], command_tbl->post_cmds, command_tbl->nr_of_post * 8);
-
-			QDomElement chapterProcessDataElement = CreateDOMElement(document, "ChapterProcessData", Utilities::EncodeHex(_buf, 1 + command_tbl->nr_of_post * 8));
-			chapterProcessDataElement.setAttribute("format", "hex");
-			chapterCommandElement.appendChild(chapterProcessDataElement);
-		}
-
-		free(_buf);
+			AddPGCCommand(writer, "Post commands", "2", command_tbl->nr_of_post, command_tbl->post_cmds);
 	}
 }
 
-uint64_t ChapterManager::HandleLanguageUnit(QDomDocument& document, QDomNode& parent, const IFOFile& _ifo, int title)
+uint64_t ChapterManager::HandleLanguageUnit(DocumentWriter& writer, const IFOFile& _ifo, int title)
 {
 	static unsigned char _PrivateLU[]  = {0x2A, 0x00, 0x00, 0x00};
 	uint64_t start_time = uint64_t(-1), found_time;
 
-	QDomElement chapterAtomElement;
-	QDomElement chapterDisplayElement;
-	QDomElement chapterStringElement;
-	QDomElement chapterTimeStartElement;
-
 	for (int i = 0 ;i < _ifo.LanguageUnits(title)->nr_of_lus; i++)
 	{
-		parent.appendChild(document.createComment("Language Units"));
+		const pgci_lu_t &_LU = _ifo.LanguageUnits(title)->lu[i];
+
+		// none of the PGCs of this language unit was selected
+		if (_LU.pgcit && IsPGCSkipped(_LU.pgcit, -1, 0, _ifo.CellsList(title, true)))
+			continue;
 
-		chapterAtomElement = document.createElement("ChapterAtom");
-		parent.appendChild(chapterAtomElement);
+		writer.writeComment("Language Units");
+
+		writer.writeStartElement("ChapterAtom");
 
 		// the Language Unit for a given language
-		const pgci_lu_t &_LU = _ifo.LanguageUnits(title)->lu[i];
 		_PrivateLU[1] = _LU.lang_code >> 8;
 		_PrivateLU[2] = _LU.lang_code & 0xFF;
 		_PrivateLU[3] = _LU.lang_extension;
 
-		chapterAtomElement.appendChild(document.createComment(QString("Language: %1%2").arg(QChar(_LU.lang_code >> 8)).arg(QChar(_LU.lang_code & 0xFF))));
-		chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterUID", Utilities::CreateUID()));
+		writer.writeComment(QString("Language: %1%2").arg(QChar(_LU.lang_code >> 8)).arg(QChar(_LU.lang_code & 0xFF)));
+		writer.writeTextElement("ChapterUID", Utilities::CreateUID());
 
-		AddCodecPrivateData(document, chapterAtomElement, _PrivateLU, 4);
+		AddCodecPrivateData(writer, _PrivateLU, 4);
 
 		// display the UID for the lazy rippers
-		chapterAtomElement.appendChild(document.createComment("Enter your text here"));
-
-		chapterDisplayElement = document.createElement("ChapterDisplay");
-		chapterAtomElement.appendChild(chapterDisplayElement);
+		writer.writeComment("Enter your text here");
 
-		chapterStringElement = document.createElement("ChapterString");
-		chapterStringElement.appendChild(document.createTextNode(QString("Language Unit for %1%2").arg(QChar(_LU.lang_code >> 8)).arg(QChar(_LU.lang_code & 0xFF))));
-		chapterDisplayElement.appendChild(chapterStringElement);
+		writer.writeStartElement("ChapterDisplay");
+		writer.writeTextElement("ChapterString", QString("Language Unit for %1%2").arg(QChar(_LU.lang_code >> 8)).arg(QChar(_LU.lang_code & 0xFF)));
+		writer.writeEndElement();
 
 		if (_LU.pgcit)
 		{
@@ -432,48 +381,92 @@ uint64_t ChapterManager::HandleLanguageUnit(QDomDocument& document, QDomNode& pa
 			{
 				const pgci_srp_t &_PGC_SRP = _LU.pgcit->pgci_srp[j];
 
-				found_time = AddPGC(document, chapterAtomElement, _PGC_SRP.pgc, j, _PGC_SRP.entry_id, _ifo.CellsList(title, true), NULL, 0);
+				if (IsPGCSkipped(_LU.pgcit, j, 0, _ifo.CellsList(title, true)))
+					continue;
+
+				found_time = AddPGC(writer, _PGC_SRP.pgc, j, _PGC_SRP.entry_id, _ifo.CellsList(title, true), NULL, 0);
 
 				if (start_time > found_time)
 					start_time = found_time;
 			}
 		}
 
-		chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterTimeStart", Utilities::FormatTime(start_time)));
+		writer.writeTextElement("ChapterTimeStart", Utilities::FormatTime(start_time));
+		writer.writeEndElement();
 	}
 
 	return start_time;
 }
 
 
-uint64_t ChapterManager::AddPGC(QDomDocument& document, QDomNode& parent, const pgc_t * pgc, uint16_t pgc_num, unsigned char pgc_type, const CellsListType & cell_list, const ttu_t * ptts, int title)
+// Tell whether one of the cells of the PGC is selected, and whether one at least is listed
+bool ChapterManager::HasSelectedCells(const pgc_t * pgc, const CellsListType & cell_list, bool& listed)
+{
+	if (!pgc || !pgc->cell_position)
+		return false;
+
+	for (int i = 0; i < pgc->nr_of_cells; i++)
+	{
+		const CellListElem *cell = cell_list.at(pgc->cell_position[i]);
+
+		if (cell)
+		{
+			listed = true;
+			if (cell->selected)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+// A PGC (or all the PGCs of the table with -1, or of a VTS_TTN when not 0) is left out
+// of the chapters when its cells are all outside the selection. The PGCs without
+// any cell only carry commands, they are kept.
+bool ChapterManager::IsPGCSkipped(const pgcit_t * pgcit, int pgc_num, int ttn, const CellsListType & cell_list)
+{
+	bool listed = false;
+
+	for (int i = 0; i < pgcit->nr_of_pgci_srp; i++)
+	{
+		if (pgc_num >= 0 && i != pgc_num)
+			continue;
+		if (ttn && (pgcit->pgci_srp[i].entry_id & 0x7F) != ttn)
+			continue;
+
+		if (HasSelectedCells(pgcit->pgci_srp[i].pgc, cell_list, listed))
+			return false;
+	}
+
+	return listed;
+}
+
+uint64_t ChapterManager::AddPGC(DocumentWriter& writer, const pgc_t * pgc, uint16_t pgc_num, unsigned char pgc_type, const CellsListType & cell_list, const ttu_t * ptts, int title)
 {
 	static unsigned char _PrivatePGC[] = {0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 	uint64_t start_time = uint64_t(-1), found_time;
 
-	parent.appendChild(document.createComment(QString("PGC PGC_%1 type %2").arg(pgc_num+1).arg(GetPGCType(pgc_type))));
+	writer.writeComment(QString("PGC PGC_%1 type %2").arg(pgc_num+1).arg(GetPGCType(pgc_type)));
 
-	QDomElement chapterAtomElement = document.createElement("ChapterAtom");
-	parent.appendChild(chapterAtomElement);
+	writer.writeStartElement("ChapterAtom");
 
 	QString _myUID = Utilities::CreateUID();
-	chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterUID", _myUID));
+	writer.writeTextElement("ChapterUID", _myUID);
 
 	// display the UID for the lazy rippers
 	if (ptts == NULL)
 	{
-		chapterAtomElement.appendChild(document.createComment("Enter your text here"));
+		writer.writeComment("Enter your text here");
 
-		QDomElement chapterDisplayElement = document.createElement("ChapterDisplay");
-		chapterDisplayElement.appendChild(CreateDOMElement(document, "ChapterString", "PGC type " + GetPGCType(pgc_type)));
-		chapterAtomElement.appendChild(chapterDisplayElement);
+		writer.writeStartElement("ChapterDisplay");
+		writer.writeTextElement("ChapterString", "PGC type " + GetPGCType(pgc_type));
+		writer.writeEndElement();
 	}
 	else
-		chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterFlagHidden", "1"));
+		writer.writeTextElement("ChapterFlagHidden", "1");
 
 	// PGC commands
-	QDomElement chapterProcessElement = document.createElement("ChapterProcess");
-	chapterAtomElement.appendChild(chapterProcessElement);
+	writer.writeStartElement("ChapterProcess");
 
 	_PrivatePGC[1] = (pgc_num+1) >> 8;
 	_PrivatePGC[2] = (pgc_num+1) & 0xFF;
@@ -483,13 +476,14 @@ uint64_t ChapterManager::AddPGC(QDomDocument& document, QDomNode& parent, const
 	_PrivatePGC[6] = ((uint8_t*) &pgc->prohibited_ops)[2];
 	_PrivatePGC[7] = ((uint8_t*) &pgc->prohibited_ops)[3];
 
-	AddCodecPrivateData(document, chapterProcessElement, _PrivatePGC, 8, false);
-	AddPGCCommands(document, chapterProcessElement, pgc->command_tbl);
+	AddCodecPrivateData(writer, _PrivatePGC, 8, false);
+	AddPGCCommands(writer, pgc->command_tbl);
+	writer.writeEndElement();
 
 	// Handle the Programs/Cells in the PGC
 	for (int i=0; i< pgc->nr_of_programs; i++)
 	{
-		found_time = AddProgram(document, chapterAtomElement, pgc, _myUID, i, cell_list, pgc_num, ptts, title);
+		found_time = AddProgram(writer, pgc, _myUID, i, cell_list, pgc_num, ptts, title);
 
 		if (start_time > found_time)
 			start_time = found_time;
@@ -498,12 +492,12 @@ uint64_t ChapterManager::AddPGC(QDomDocument& document, QDomNode& parent, const
 	if (start_time == uint64_t(-1))
 		start_time = 0;
 
-	chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterTimeStart", Utilities::FormatTime(start_time)));
+	writer.writeTextElement("ChapterTimeStart", Utilities::FormatTime(start_time));
+	writer.writeEndElement();
 
 	return start_time;
 }
 
-
 QString ChapterManager::GetPGCType(unsigned char entry_id)
 {
 	QString result ("0x%1 = ");
@@ -541,7 +535,7 @@ QString ChapterManager::GetPGCType(unsigned char entry_id)
 }
 
 
-uint64_t ChapterManager::AddProgram(QDomDocument& document, QDomNode& parent, const pgc_t *pgc, const QString& PgcUID, int program_number, const CellsListType& cell_list, int16_t pgc_num, const ttu_t *ptts, int title)
+uint64_t ChapterManager::AddProgram(DocumentWriter& writer, const pgc_t *pgc, const QString& PgcUID, int program_number, const CellsListType& cell_list, int16_t pgc_num, const ttu_t *ptts, int title)
 {
 	static unsigned char _PrivatePTT[] = {0x10, 0x00};
 	static unsigned char _PrivatePG[] = {0x18, 0x00, 0x00};
@@ -558,18 +552,17 @@ uint64_t ChapterManager::AddProgram(QDomDocument& document, QDomNode& parent, co
 	else
 		next_program_entry_cell_num = pgc->program_map[program_number+1];
 
-	parent.appendChild(document.createComment(QString("Program PGN# %1 in this PGC").arg(program_number + 1)));
+	writer.writeComment(QString("Program PGN# %1 in this PGC").arg(program_number + 1));
 
-	QDomElement chapterAtomElement = document.createElement("ChapterAtom");
-	parent.appendChild(chapterAtomElement);
+	writer.writeStartElement("ChapterAtom");
 
 	QString _myUID = Utilities::CreateUID();
-	chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterUID", _myUID));
-	chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterFlagHidden", "1"));
+	writer.writeTextElement("ChapterUID", _myUID);
+	writer.writeTextElement("ChapterFlagHidden", "1");
 
 	_PrivatePG[1] = (program_number+1) >> 8;
 	_PrivatePG[2] = (program_number+1) & 0xFF;
-	AddCodecPrivateData(document, chapterAtomElement, _PrivatePG, 3);
+	AddCodecPrivateData(writer, _PrivatePG, 3);
 
 	if (ptts != NULL)
 	{
@@ -585,36 +578,30 @@ uint64_t ChapterManager::AddProgram(QDomDocument& document, QDomNode& parent, co
 			
 			start_time = cell_elt->start_time;
 
-			QDomElement chapterAtomParent = chapterAtomElement;
-
 			if (ptts->ptt[pppt_nr].pgcn == pgc_num+1 && ptts->ptt[pppt_nr].pgn == program_number+1)
 			{
-				chapterAtomElement.appendChild(document.createComment(QString("Chapter PTT#%1 [%2.%3]").arg(pppt_nr+1).arg(pgc_num+1, 2, 10, QChar('0')).arg(program_number+1, 2, 10, QChar('0'))));
+				writer.writeComment(QString("Chapter PTT#%1 [%2.%3]").arg(pppt_nr+1).arg(pgc_num+1, 2, 10, QChar('0')).arg(program_number+1, 2, 10, QChar('0')));
 				
-				chapterAtomElement = document.createElement("ChapterAtom");
-				chapterAtomParent.appendChild(chapterAtomElement);
+				writer.writeStartElement("ChapterAtom");
 
-				chapterAtomElement.appendChild(document.createComment("Enter your text here"));
+				writer.writeComment("Enter your text here");
 
-				QDomElement chapterDisplayElement = document.createElement("ChapterDisplay");
-				chapterDisplayElement.appendChild(CreateDOMElement(document, "ChapterString", QString("Your Name Here For Chapter #%1.%2").arg(title).arg(pppt_nr + 1)));
-				chapterAtomElement.appendChild(chapterDisplayElement);
+				writer.writeStartElement("ChapterDisplay");
+				writer.writeTextElement("ChapterString", QString("Your Name Here For Chapter #%1.%2").arg(title).arg(pppt_nr + 1));
+				writer.writeEndElement();
 
 				QString _myUID = Utilities::CreateUID();
-				chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterUID", _myUID));
+				writer.writeTextElement("ChapterUID", _myUID);
 
 				_PrivatePTT[1] = pppt_nr+1;
-				AddCodecPrivateData(document, chapterAtomElement, _PrivatePTT, 2);
+				AddCodecPrivateData(writer, _PrivatePTT, 2);
 
-				chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterTimeStart", Utilities::FormatTime(start_time)));
+				writer.writeTextElement("ChapterTimeStart", Utilities::FormatTime(start_time));
+				writer.writeEndElement();
 			}
-
-			chapterAtomElement = chapterAtomParent;
 		}
 	}
 
-	QDomElement parentChapterAtom = chapterAtomElement;
-
 	for (int cell_num = entry_cell_num; cell_num<next_program_entry_cell_num; cell_num++)
 	{
 		// Output cells
@@ -634,44 +621,42 @@ uint64_t ChapterManager::AddProgram(QDomDocument& document, QDomNode& parent, co
 		QString suffix = QString(" (%1 angles)").arg(cell_num - entry_cell_num + 1);
 
 		if (cell.block_mode) // multi-angle
-			parentChapterAtom.appendChild(document.createComment(prefix + middle + suffix));
+			writer.writeComment(prefix + middle + suffix);
 		else
-			parentChapterAtom.appendChild(document.createComment(prefix + middle));
+			writer.writeComment(prefix + middle);
 
-		QDomElement chapterAtomElement = document.createElement("ChapterAtom");
-		parentChapterAtom.appendChild(chapterAtomElement);
+		writer.writeStartElement("ChapterAtom");
 
 		QString _myUID = Utilities::CreateUID();
-		chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterUID", _myUID));
-		chapterAtomElement.appendChild(CreateDOMElement(document, "ChapterFlagHidden", "1"));
+		writer.writeTextElement("ChapterUID", _myUID);
+		writer.writeTextElement("ChapterFlagHidden", "1");
 
 		_PrivateCN[1] = (position.vob_id_nr) >> 8;
 		_PrivateCN[2] = (position.vob_id_nr) & 0xFF;
 		_PrivateCN[3] = position.cell_nr;
 		_PrivateCN[4] = cell_num - entry_cell_num + 1; // Number of angles
-		AddCodecPrivateData(document, chapterAtomElement, _PrivateCN, 5);
+		AddCodecPrivateData(writer, _PrivateCN, 5);
 
 		if (cell.still_time == 0xFF) {
-			chapterAtomElement.appendChild(document.createComment("Infinite loop Still Cell"));
+			writer.writeComment("Infinite loop Still Cell");
 
 			// output an additional tag to specify this is cell should loop infinitely
 			// post-process command, jump to timecode "st_time"
-			QDomElement chapterProcessElement = document.createElement("ChapterProcess");
-			chapterProcessElement.appendChild(CreateDOMElement(document, "ChapterProcessCodecID", "0"));
-			chapterProcessElement.appendChild(document.createComment("Post command: replay this cell"));
-			chapterAtomElement.appendChild(chapterProcessElement);
-
-			QDomElement chapterProcessCommand = document.createElement("ChapterProcessCommand");
-			chapterProcessCommand.appendChild(CreateDOMElement(document, "ChapterProcessTime", "2"));
-			chapterProcessElement.appendChild(chapterProcessCommand);
-
-			QDomElement chapterProcessDataElement = CreateDOMElement(document, "ChapterProcessData", "GotoAndPlay(" + PgcUID + ");" );
-			chapterProcessDataElement.setAttribute("format", "ascii");
-			chapterProcessCommand.appendChild(chapterProcessDataElement);
+			writer.writeStartElement("ChapterProcess");
+			writer.writeTextElement("ChapterProcessCodecID", "0");
+			writer.writeComment("Post command: replay this cell");
+
+			writer.writeStartElement("ChapterProcessCommand");
+			writer.writeTextElement("ChapterProcessTime", "2");
+			writer.writeTextElement("ChapterProcessData", "GotoAndPlay(" + PgcUID + ");", "format", "ascii");
+			writer.writeEndElement();
+
+			writer.writeEndElement();
 		} else if (cell.still_time != 0)
-			chapterAtomElement.appendChild(document.createComment(QString("Still cell (%1s)").arg(cell.still_time)));
+			writer.writeComment(QString("Still cell (%1s)").arg(cell.still_time));
 
-		AddChapterTime(document, chapterAtomElement, cell_elt->start_time, cell_elt->start_time + cell_elt->duration);
+		AddChapterTime(writer, cell_elt->start_time, cell_elt->start_time + cell_elt->duration);
+		writer.writeEndElement();
 
 		if (end_time < cell_elt->start_time + cell_elt->duration)
 			end_time = cell_elt->start_time + cell_elt->duration;
@@ -683,7 +668,8 @@ uint64_t ChapterManager::AddProgram(QDomDocument& document, QDomNode& parent, co
 	if (start_time == uint64_t(-1))
 		start_time = 0; // unknown
 
-	parentChapterAtom.appendChild(CreateDOMElement(document, "ChapterTimeStart", Utilities::FormatTime(start_time)));
+	writer.writeTextElement("ChapterTimeStart", Utilities::FormatTime(start_time));
+	writer.writeEndElement();
 
 	return start_time;
 }
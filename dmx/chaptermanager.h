@@ -4,15 +4,16 @@
 #include <QString>
 #include "vobparser/IFOFile.h"
 
-class QDomNode;
-class QDomElement;
-class QDomDocument;
+class QFile;
+class DocumentWriter;
 
 class ChapterManager
 {
 public:
-	ChapterManager(unsigned xmlIdentCount)
-		: INDENT_COUNT(xmlIdentCount)
+	enum Format {FORMAT_XML, FORMAT_EBML};
+
+	ChapterManager(unsigned xmlIdentCount, Format format = FORMAT_XML)
+		: INDENT_COUNT(xmlIdentCount), format_(format)
 	{
 	}
 	bool generateScript(const IFOFile& ifoFile, const QString& filename, uint16_t title, const QString& editionUID) const;
@@ -20,21 +21,30 @@ public:
 
 	static QString INFO_SUFFIX;
 	static QString CHAPTER_SUFFIX;
+	static QString EBML_INFO_SUFFIX;
+	static QString EBML_CHAPTER_SUFFIX;
+
+	// suffixes of the files written in the current format
+	QString chapterSuffix() const;
+	QString infoSuffix() const;
 
 private:
-	void generateInfoScript(const QString& filename, uint16_t title, const QString& editionUID) const;
+	void generateInfoScript(const IFOFile& ifoFile, const QString& filename, uint16_t title, const QString& editionUID) const;
+	DocumentWriter* createWriter(QFile& file) const;
 	
-	static QDomElement CreateDOMElement(QDomDocument& document, const QString& elementName, const QString& content);
-	static void AddChapterTime(QDomDocument& document, QDomNode& parent, uint64_t start_time, uint64_t end_time);
-	static void AddCodecPrivateData(QDomDocument& document, QDomNode& parent, const unsigned char *buffer, unsigned int size, bool createChapterProcessElement = true);
-	static void AddPGCCommands(QDomDocument& document, QDomNode& parent, const pgc_command_tbl_t * command_tbl);
-	static uint64_t AddProgram(QDomDocument& document, QDomNode& parent, const pgc_t *pgc, const QString& PgcUID, int program_number, const CellsListType& cell_list, int16_t pgc_num, const ttu_t *ptts, int title);
-	static uint64_t AddPGC(QDomDocument& document, QDomNode& parent, const pgc_t * pgc, uint16_t pgc_num, unsigned char pgc_type, const CellsListType & cell_list, const ttu_t * ptts, int title);
+	static void AddChapterTime(DocumentWriter& writer, uint64_t start_time, uint64_t end_time);
+	static void AddCodecPrivateData(DocumentWriter& writer, const unsigned char *buffer, unsigned int size, bool createChapterProcessElement = true);
+	static void AddPGCCommand(DocumentWriter& writer, const QString& comment, const QString& time, uint8_t count, const vm_cmd_t *commands);
+	static void AddPGCCommands(DocumentWriter& writer, const pgc_command_tbl_t * command_tbl);
+	static uint64_t AddProgram(DocumentWriter& writer, const pgc_t *pgc, const QString& PgcUID, int program_number, const CellsListType& cell_list, int16_t pgc_num, const ttu_t *ptts, int title);
+	static uint64_t AddPGC(DocumentWriter& writer, const pgc_t * pgc, uint16_t pgc_num, unsigned char pgc_type, const CellsListType & cell_list, const ttu_t * ptts, int title);
+	static bool HasSelectedCells(const pgc_t * pgc, const CellsListType & cell_list, bool& listed);
+	static bool IsPGCSkipped(const pgcit_t * pgcit, int pgc_num, int ttn, const CellsListType & cell_list);
 	static QString GetPGCType(unsigned char entry_id);
-	static uint64_t HandleLanguageUnit(QDomDocument& document, QDomNode& parent, const IFOFile& _ifo, int title);
+	static uint64_t HandleLanguageUnit(DocumentWriter& writer, const IFOFile& _ifo, int title);
 
-	uint8_t familyUID[16];
 	unsigned INDENT_COUNT;
+	Format format_;
 };
 
 #endif //CHAPTER_MANAGER_H
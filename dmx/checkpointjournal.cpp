@@ -0,0 +1,179 @@
+#include "checkpointjournal.h"
+
+#include <QHash>
+#include <QFile>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QStringList>
+
+QString CheckpointJournal::SUFFIX (".checkpoint");
+
+static const QString JOURNAL_HEADER ("# DMX checkpoint v2");
+
+CheckpointJournal::CheckpointJournal(const QString& prefix, const QByteArray& fingerprint)
+	: filename_(prefix + SUFFIX), fingerprint_(fingerprint), lastSector_(0)
+{
+	timer_.start();
+}
+
+bool CheckpointJournal::isDue(uint32_t sector) const
+{
+	return sector >= lastSector_ + MIN_SECTORS || timer_.elapsed() >= MIN_INTERVAL;
+}
+
+bool CheckpointJournal::save(VobParser& parser, const CellsListType& cells)
+{
+	CompositeDemuxWriter& demuxer = parser.GetDemuxer();
+
+	// the journal is replaced atomically, a crash while saving keeps the previous checkpoint
+	QSaveFile file(filename_);
+
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+		return false;
+
+	QTextStream out(&file);
+
+	lastSector_ = parser.GetPacketIndex();
+	timer_.restart();
+
+	out << JOURNAL_HEADER << '\n';
+	out << "fingerprint " << fingerprint_.toHex() << '\n';
+	out << "sectors " << parser.GetPacketCount() << '\n';
+	// the navigation pack that started the current cell
+	out << "sector " << parser.GetPacketIndex() - 1 << '\n';
+	out << "timecode " << parser.GetTimecodeOffset() << '\n';
+
+	CellsListType::const_iterator cell = cells.begin();
+	for (; cell != cells.end(); ++cell)
+	{
+		if (cell->found)
+			out << "cell " << cell->vobid << ' ' << cell->cellid << '\n';
+	}
+
+	for (int streamID = 0; streamID < 256; ++streamID)
+	{
+		Writer *writer = demuxer.GetWriter(streamID);
+
+		if (writer == NULL)
+			continue;
+
+		WriterState state;
+		writer->SaveState(state);
+
+		out << "stream " << streamID
+			<< ' ' << qint64(state.file_size) << ' ' << qint64(state.timecode_file_size)
+			<< ' ' << state.start_timecode << ' ' << state.end_timecode
+			<< ' ' << state.last_start_timecode << ' ' << state.last_end_timecode
+			<< ' ' << int(state.is_still)
+			<< ' ' << quint64(state.riff_size_position) << ' ' << quint64(state.data_size_position)
+			<< ' ' << quint64(state.data_size) << '\n';
+	}
+
+	out.flush();
+	return file.commit();
+}
+
+bool CheckpointJournal::restore(VobParser& parser, const CellsListType& cells)
+{
+	QFile file(filename_);
+
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		return false;
+
+	QTextStream in(&file);
+
+	if (in.readLine() != JOURNAL_HEADER)
+		return false;
+
+	bool hasSector = false;
+	QByteArray fingerprint;
+	uint32_t sectors = 0, sector = 0, timecodeOffset = 0;
+	QList<int> foundCells;
+	QHash<int, WriterState> states;
+
+	while (!in.atEnd())
+	{
+		const QStringList fields = in.readLine().split(' ', QString::SkipEmptyParts);
+
+		if (fields.isEmpty())
+			continue;
+
+		if (fields.at(0) == "fingerprint" && fields.size() == 2)
+			fingerprint = QByteArray::fromHex(fields.at(1).toLatin1());
+		else if (fields.at(0) == "sectors" && fields.size() == 2)
+			sectors = fields.at(1).toUInt();
+		else if (fields.at(0) == "sector" && fields.size() == 2)
+			sector = fields.at(1).toUInt(&hasSector);
+		else if (fields.at(0) == "timecode" && fields.size() == 2)
+			timecodeOffset = fields.at(1).toUInt();
+		else if (fields.at(0) == "cell" && fields.size() == 3)
+			foundCells.append(MAKE_CELLS_KEY(fields.at(1).toInt(), fields.at(2).toInt()));
+		else if (fields.at(0) == "stream" && fields.size() == 12)
+		{
+			WriterState state;
+
+			state.file_size = fields.at(2).toLongLong();
+			state.timecode_file_size = fields.at(3).toLongLong();
+			state.start_timecode = fields.at(4).toUInt();
+			state.end_timecode = fields.at(5).toUInt();
+			state.last_start_timecode = fields.at(6).toUInt();
+			state.last_end_timecode = fields.at(7).toUInt();
+			state.is_still = fields.at(8).toInt() != 0;
+			state.riff_size_position = fields.at(9).toULongLong();
+			state.data_size_position = fields.at(10).toULongLong();
+			state.data_size = fields.at(11).toULongLong();
+
+			states.insert(fields.at(1).toInt(), state);
+		}
+		else
+		{
+			fprintf(stderr, "Ignoring malformed checkpoint '%s'\n", qPrintable(filename_));
+			return false;
+		}
+	}
+
+	file.close();
+
+	// the checkpoint must belong to the same disc, the same selection and the same VOB set
+	if (fingerprint != fingerprint_ || !hasSector || sectors != parser.GetPacketCount() || sector >= sectors)
+		return false;
+
+	CompositeDemuxWriter& demuxer = parser.GetDemuxer();
+
+	for (int streamID = 0; streamID < 256; ++streamID)
+	{
+		if ((demuxer.GetWriter(streamID) != NULL) != states.contains(streamID))
+			return false;
+	}
+
+	if (!parser.Resume(sector, timecodeOffset))
+	{
+		parser.Reset();
+		return false;
+	}
+
+	QHash<int, WriterState>::const_iterator state = states.constBegin();
+	for (; state != states.constEnd(); ++state)
+	{
+		if (!demuxer.GetWriter(state.key())->RestoreState(state.value()))
+			throw VobParserException("Could not restore the outputs of the interrupted extraction");
+	}
+
+	for (int index = 0; index < foundCells.size(); ++index)
+	{
+		CellListElem *cell = cells.at(foundCells.at(index) >> 8, foundCells.at(index) & 0xFF);
+
+		if (cell != NULL)
+			cell->found = true;
+	}
+
+	lastSector_ = sector;
+	timer_.restart();
+
+	return true;
+}
+
+void CheckpointJournal::remove()
+{
+	QFile::remove(filename_);
+}
@@ -0,0 +1,42 @@
+#ifndef CHECKPOINT_JOURNAL_H
+#define CHECKPOINT_JOURNAL_H
+
+#include <QString>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include "vobparser/IFOFile.h"
+
+// Keeps track of the progress of a demuxing pass so an interrupted extraction
+// can be resumed from the last cell boundary instead of sector 0
+class CheckpointJournal
+{
+public:
+	// the fingerprint identifies the disc, the selection and the options of the pass
+	CheckpointJournal(const QString& prefix, const QByteArray& fingerprint);
+
+	// A checkpoint flushes every writer and syncs the journal, it is only worth
+	// it every MIN_SECTORS sectors or MIN_INTERVAL ms
+	bool isDue(uint32_t sector) const;
+
+	// Record the parser position, the writer offsets and the found cells
+	bool save(VobParser& parser, const CellsListType& cells);
+
+	// Truncate the outputs to the last checkpoint and move the parser after it
+	bool restore(VobParser& parser, const CellsListType& cells);
+
+	// Forget the checkpoint once the pass is complete
+	void remove();
+
+	static QString SUFFIX;
+
+	static const uint32_t MIN_SECTORS = 64 * 1024;
+	static const qint64 MIN_INTERVAL = 10000;
+
+private:
+	QString filename_;
+	QByteArray fingerprint_;
+	uint32_t lastSector_;
+	QElapsedTimer timer_;
+};
+
+#endif // CHECKPOINT_JOURNAL_H
@@ -0,0 +1,123 @@
+#include "contentstore.h"
+
+#include <stdio.h>
+#include <QFile>
+#include <QFileInfo>
+#include <QCryptographicHash>
+
+#if (defined(WIN32) || defined(WIN64))
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+ContentStore::ContentStore()
+	: linkedBytes_(0)
+{
+}
+
+void ContentStore::clear()
+{
+	entries_.clear();
+	linkedBytes_ = 0;
+}
+
+QString ContentStore::add(const QString& filename)
+{
+	const qint64 size = QFileInfo(filename).size();
+
+	// nothing to save on an empty file
+	if (size <= 0)
+		return QString();
+
+	QByteArray hash;
+	QList<Entry>& entries = entries_[size];
+
+	for (int index = 0; index < entries.size(); )
+	{
+		Entry& entry = entries[index];
+
+		if (entry.filename == filename)
+			return QString();
+
+		if (hash.isEmpty())
+			hash = hashFile(filename);
+		if (entry.hash.isEmpty())
+			entry.hash = hashFile(entry.filename);
+
+		// the file may have been removed since, like the files of a muxed pass
+		if (entry.hash.isEmpty())
+		{
+			entries.removeAt(index);
+			continue;
+		}
+
+		if (hash.isEmpty())
+			return QString();
+
+		if (entry.hash == hash && linkFile(entry.filename, filename))
+		{
+			linkedBytes_ += size;
+			return entry.filename;
+		}
+		++index;
+	}
+
+	Entry entry;
+	entry.filename = filename;
+	entry.hash = hash;
+	entries.append(entry);
+
+	return QString();
+}
+
+QByteArray ContentStore::hashFile(const QString& filename)
+{
+	QFile file(filename);
+
+	if (!file.open(QIODevice::ReadOnly))
+		return QByteArray();
+
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	QByteArray buffer;
+
+	do
+	{
+		buffer = file.read(BUFFER_SIZE);
+		hash.addData(buffer);
+	} while (buffer.size() == BUFFER_SIZE);
+
+	if (file.error() != QFile::NoError)
+		return QByteArray();
+
+	return hash.result();
+}
+
+// The link is created beside the file then renamed over it, so the file is
+// never missing if the link can't be made
+bool ContentStore::linkFile(const QString& target, const QString& filename)
+{
+	const QString temporary = filename + ".link";
+	QFile::remove(temporary);
+
+#if (defined(WIN32) || defined(WIN64))
+	if (!CreateHardLinkW((LPCWSTR)temporary.utf16(), (LPCWSTR)target.utf16(), NULL))
+		return false;
+
+	const bool replaced = MoveFileExW((LPCWSTR)temporary.utf16(), (LPCWSTR)filename.utf16(), MOVEFILE_REPLACE_EXISTING);
+#else
+	if (link(QFile::encodeName(target), QFile::encodeName(temporary)) != 0)
+		return false;
+
+	const bool replaced = (rename(QFile::encodeName(temporary), QFile::encodeName(filename)) == 0);
+#endif
+
+	if (!replaced)
+	{
+		fprintf(stderr, "Could not replace %s with a link\n", qPrintable(filename));
+		QFile::remove(temporary);
+		return false;
+	}
+
+	return true;
+}
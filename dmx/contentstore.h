@@ -0,0 +1,46 @@
+#ifndef CONTENT_STORE_H
+#define CONTENT_STORE_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QByteArray>
+
+// Remembers the files written for a disc by size and content, so a file that is
+// identical to an earlier one can be replaced with a hard link to it. The menus
+// of the title sets often repeat the same backgrounds and buttons. The MD5 of a
+// file is only computed once another file of the same size is added.
+// A linked file must never be rewritten in place: the writers remove an output
+// before creating it, and give a resumed output its own copy before truncating it.
+class ContentStore
+{
+public:
+	ContentStore();
+
+	void clear();
+
+	// Link the file to an identical one already in the store, or add it.
+	// Returns the path the file is now linked to, empty if it was kept.
+	QString add(const QString& filename);
+
+	// bytes no longer taking space on the disk
+	qint64 linkedBytes() const { return linkedBytes_; }
+
+	static const qint64 BUFFER_SIZE = 256 * 1024;
+
+private:
+	struct Entry
+	{
+		QString filename;
+		QByteArray hash;
+	};
+
+	static QByteArray hashFile(const QString& filename);
+	static bool linkFile(const QString& target, const QString& filename);
+
+	// files by size
+	QHash<qint64, QList<Entry> > entries_;
+	qint64 linkedBytes_;
+};
+
+#endif // CONTENT_STORE_H
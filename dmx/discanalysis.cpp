@@ -0,0 +1,181 @@
+#include "discanalysis.h"
+#include "utilities.h"
+#include "vobparser/VobParser.h"
+#include "vobparser/IFOFile.h"
+
+#include <QSaveFile>
+#include <QJsonDocument>
+
+QString DiscAnalysis::FILENAME ("dmx_analysis.json");
+
+static const char *AUDIO_FORMATS[8] = {"ac3", "unknown", "mpa", "mpa", "lpcm", "unknown", "dts", "unknown"};
+
+static QString Language(uint16_t code)
+{
+	if (code == 0)
+		return "und";
+
+	return QString("%1%2").arg(QChar(code >> 8)).arg(QChar(code & 0xFF));
+}
+
+DiscAnalysis::DiscAnalysis()
+{
+}
+
+void DiscAnalysis::start(const QString& sourcePath)
+{
+	sourcePath_ = sourcePath;
+	pass_ = QJsonObject();
+	cells_.clear();
+	passes_ = QJsonArray();
+}
+
+void DiscAnalysis::beginPass(const QString& name, const IFOFile& ifo, int16_t title, bool menu)
+{
+	pass_ = QJsonObject();
+	cells_.clear();
+
+	pass_.insert("name", name);
+
+	double fps = 0;
+	uint16_t width = 0, height = 0;
+
+	if (ifo.VideoSize(title, menu, width, height, fps))
+	{
+		QJsonObject video;
+		video.insert("width", width);
+		video.insert("height", height);
+		video.insert("fps", fps);
+		pass_.insert("video", video);
+	}
+
+	const AudioTrackList& audioTracks = ifo.AudioTracks(title, menu);
+	QJsonArray audio;
+
+	for (size_t stream = 0; stream < audioTracks.size(); ++stream)
+	{
+		const audio_attr_t *attr = audioTracks[stream];
+
+		QJsonObject track;
+		track.insert("id", ifo.GetAudioId(stream, title, menu));
+		track.insert("format", AUDIO_FORMATS[attr->audio_format]);
+		track.insert("language", Language(attr->lang_code));
+		track.insert("channels", attr->channels + 1);
+		audio.append(track);
+	}
+
+	pass_.insert("audio", audio);
+
+	const SubtitleTrackList& subTracks = ifo.SubsTracks(title, menu);
+	QJsonArray subtitles;
+
+	for (size_t stream = 0; stream < subTracks.size(); ++stream)
+	{
+		// one stream per display mode, see GetSubsId
+		const IdArray ids = ifo.GetSubsId(stream, title, menu);
+		QJsonArray idList;
+		for (IdArray::size_type index = 0; index < ids.size(); ++index)
+			idList.append(ids.at(index));
+
+		QJsonObject track;
+		track.insert("ids", idList);
+		track.insert("language", Language(subTracks[stream]->lang_code));
+		subtitles.append(track);
+	}
+
+	pass_.insert("subtitles", subtitles);
+}
+
+void DiscAnalysis::addVOBU(const VobParser& parser, uint32_t sector)
+{
+	// the cells of the angles are interleaved, a cell may come back after another one
+	CellEntry *entry = 0;
+	for (size_t index = cells_.size(); index > 0 && !entry; --index)
+	{
+		if (cells_[index - 1].vob == parser.GetVobID() && cells_[index - 1].cell == parser.GetCellID())
+			entry = &cells_[index - 1];
+	}
+
+	if (!entry)
+	{
+		CellEntry cell;
+		cell.vob = parser.GetVobID();
+		cell.cell = parser.GetCellID();
+		cell.firstSector = sector;
+		cell.lastSector = sector;
+		cell.sectors = 0;
+		cell.vobus = 0;
+		cell.startPTM = parser.m_pci.vobu_s_ptm;
+		cell.endPTM = parser.m_pci.vobu_e_ptm;
+		cell.buttons = 0;
+		cells_.push_back(cell);
+		entry = &cells_.back();
+	}
+
+	const uint32_t lastSector = sector + parser.m_dsi.vobu_ea;
+
+	entry->vobus++;
+	entry->sectors += parser.m_dsi.vobu_ea + 1;
+	entry->lastSector = qMax(entry->lastSector, lastSector);
+	entry->startPTM = qMin(entry->startPTM, (uint32_t)parser.m_pci.vobu_s_ptm);
+	entry->endPTM = qMax(entry->endPTM, (uint32_t)parser.m_pci.vobu_e_ptm);
+	entry->buttons = qMax(entry->buttons, (uint8_t)parser.m_pci.btn_ns);
+}
+
+void DiscAnalysis::endPass(const VobParser& parser)
+{
+	QJsonArray cells;
+	uint32_t vobus = 0;
+
+	for (size_t index = 0; index < cells_.size(); ++index)
+	{
+		const CellEntry& entry = cells_[index];
+		// PTM are in 90 kHz units
+		const double duration = (entry.endPTM - entry.startPTM) / 90000.0;
+
+		QJsonObject cell;
+		cell.insert("vob", entry.vob);
+		cell.insert("cell", entry.cell);
+		cell.insert("first_sector", double(entry.firstSector));
+		cell.insert("last_sector", double(entry.lastSector));
+		cell.insert("vobus", double(entry.vobus));
+		cell.insert("start_ptm", double(entry.startPTM));
+		cell.insert("end_ptm", double(entry.endPTM));
+		cell.insert("buttons", entry.buttons);
+		if (duration > 0)
+			cell.insert("bitrate", entry.sectors * double(DVD_VIDEO_LB_LEN) * 8 / duration);
+		cells.append(cell);
+
+		vobus += entry.vobus;
+	}
+
+	pass_.insert("sectors", double(parser.GetPacketCount()));
+	pass_.insert("sectors_read", double(parser.GetSectorsRead()));
+	pass_.insert("vobus", double(vobus));
+	pass_.insert("cells", cells);
+
+	passes_.append(pass_);
+	pass_ = QJsonObject();
+	cells_.clear();
+}
+
+bool DiscAnalysis::save(const QString& filename) const
+{
+	QJsonObject analysis;
+
+	analysis.insert("application", Utilities::APPLICATION_NAME);
+	analysis.insert("version", Utilities::APPLICATION_VERSION);
+	analysis.insert("source", sourcePath_);
+	analysis.insert("passes", passes_);
+
+	QSaveFile file(filename);
+
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		fprintf(stderr, "Could not write the disc analysis '%s'\n", qPrintable(filename));
+		return false;
+	}
+
+	file.write(QJsonDocument(analysis).toJson());
+	return file.commit();
+}
@@ -0,0 +1,53 @@
+#ifndef DISC_ANALYSIS_H
+#define DISC_ANALYSIS_H
+
+#include <vector>
+#include <stdint.h>
+#include <QString>
+#include <QJsonArray>
+#include <QJsonObject>
+
+class VobParser;
+class IFOFile;
+
+// Inventory of a disc built from the navigation packs only: the streams
+// declared in the IFO files, and for each cell the VOBUs found, the PTM range,
+// the number of buttons and the average bitrate. Written as JSON.
+class DiscAnalysis
+{
+public:
+	DiscAnalysis();
+
+	void start(const QString& sourcePath);
+
+	// the streams of the pass are the ones the IFO file declares
+	void beginPass(const QString& name, const IFOFile& ifo, int16_t title, bool menu);
+	// VOBU whose navigation pack was just parsed at the given sector
+	void addVOBU(const VobParser& parser, uint32_t sector);
+	void endPass(const VobParser& parser);
+
+	bool save(const QString& filename) const;
+
+	static QString FILENAME;
+
+private:
+	struct CellEntry
+	{
+		uint8_t vob;
+		uint8_t cell;
+		uint32_t firstSector;
+		uint32_t lastSector;
+		uint32_t sectors;
+		uint32_t vobus;
+		uint32_t startPTM;
+		uint32_t endPTM;
+		uint8_t buttons;
+	};
+
+	QString sourcePath_;
+	QJsonObject pass_;
+	std::vector<CellEntry> cells_;
+	QJsonArray passes_;
+};
+
+#endif // DISC_ANALYSIS_H
@@ -1,13 +1,19 @@
 #include "dmx.h"
 #include "utilities.h"
-#include "chaptermanager.h"
+#include "checkpointjournal.h"
+#include "progressmeter.h"
+#include "muxjob.h"
+#include "vobparser/MatroskaMuxer.h"
 
 #include <QDir>
+#include <QFileInfo>
+#include <QCryptographicHash>
 #include <QTime>
 #include <QMutexLocker>
+#include <QScopedPointer>
 
 DMX::DMX(bool consoleMode)
-	: ifoFile_(0), consoleMode_(consoleMode), needsAbort_(false)
+	: ifoFile_(0), consoleMode_(consoleMode), needsAbort_(false), resumeEnabled_(false), skipUpToDate_(false), chaptersOnly_(false), analyzeOnly_(false), chapterFormat_(ChapterManager::FORMAT_XML), deterministicUIDs_(false), matroskaOutput_(false), backgroundMux_(false), linkDuplicates_(false), angle_(0), resync_(false), muxJob_(0), metricsPublisher_(0)
 {
 }
 
@@ -26,6 +32,7 @@ void DMX::abort()
 {
 	QMutex mutex;
 	mutex.lock();
+	abortTimer_.start();
 	needsAbort_ = true;
 	mutex.unlock();
 
@@ -34,6 +41,7 @@ void DMX::abort()
 
 void DMX::processTitle(int16_t title, int index)
 {
+	Utilities::SeedUID(discID_, title, deterministicUIDs_);
 	const QString editionUID = Utilities::CreateUID();
 
 	unsigned stepIndex = 0;
@@ -44,8 +52,51 @@ void DMX::processTitle(int16_t title, int index)
 
 	do
 	{
+		const QString name = passName(title, menu);
+		const QByteArray fingerprint = passFingerprint(title, index);
+
+		// the cells left out are neither read nor written to the chapters
+		ifoFile_->SelectCells(title, menu, (index >= 0) ? selection_[index].pgcs() : PgcSelectionList(), angle_);
+
+		// nothing is written but the analysis, the manifest is left alone
+		if (analyzeOnly_)
+		{
+			analyze(title, menu);
+			menu = !menu && ((index < 0) || selection_[index].isMenu());
+			continue;
+		}
+
+		if (skipUpToDate_ && manifest_.isUpToDate(name, fingerprint))
+		{
+			printf("Skipping %s, outputs are up to date\n", qPrintable(name));
+			menu = !menu && ((index < 0) || selection_[index].isMenu());
+			continue;
+		}
+
 		printf("Treating Title %d %s VOB file(s)\n", title, menu ? "Menu" : "");
 
+		if (chaptersOnly_)
+		{
+			str = QString("Extracting chapters...");
+
+			if (consoleMode_)
+				printf(qPrintable(str + '\n'));
+			else
+				emit stepChanged(str);
+
+			QStringList outputFiles;
+
+			if (extractChapters(title, menu, editionUID, outputFiles))
+				manifest_.update(name, fingerprint, outputFiles);
+			else
+				manifest_.remove(name);
+
+			manifest_.save();
+
+			menu = !menu && ((index < 0) || selection_[index].isMenu());
+			continue;
+		}
+
 		stepIndex = 1;
 
 		str = text.arg(stepIndex++).arg("Building VOB map");
@@ -55,7 +106,9 @@ void DMX::processTitle(int16_t title, int index)
 		else
 			emit stepChanged(str);
 
+		RunReport::StageTimer vobMapTimer(report_, RunReport::STAGE_VOB_MAP);
 		aVobParser = buildVobParser(title, menu);
+		vobMapTimer.stop();
 
 		str = text.arg(stepIndex++).arg("Splitting and demuxing");
 		
@@ -64,9 +117,30 @@ void DMX::processTitle(int16_t title, int index)
 		else
 			emit stepChanged(str);
 		
-		demux(aVobParser, index, editionUID, title, menu);
+		QStringList outputFiles;
+
+		if (demux(aVobParser, index, editionUID, title, menu, outputFiles))
+		{
+			// a pass that skipped damaged sectors is retried by the next run
+			const bool damaged = aVobParser && !aVobParser->GetSkippedSectors().empty();
+
+			// the built-in muxer leaves no script to run, a muxed pass is only
+			// up to date once mkvmerge wrote its .mkv
+			if (backgroundMux_ && !matroskaOutput_)
+			{
+				manifest_.remove(name);
+				startMux(name, damaged ? QByteArray() : fingerprint, outputFiles);
+			}
+			else if (damaged)
+				manifest_.remove(name);
+			else
+				manifest_.update(name, fingerprint, outputFiles);
+		}
+		else
+			manifest_.remove(name);
 
 		delete aVobParser;
+		manifest_.save();
 		
 		menu = !menu && ((index < 0) || selection_[index].isMenu());
 	} while (menu && !needsAbort_);
@@ -117,17 +191,155 @@ bool DMX::setExtractionParameters(const QString& sourcePath, const QString& dest
 	return true;
 }
 
+void DMX::setResumeEnabled(bool enabled)
+{
+	resumeEnabled_ = enabled;
+}
+
+void DMX::setSkipUpToDate(bool enabled)
+{
+	skipUpToDate_ = enabled;
+}
+
+void DMX::setChaptersOnly(bool enabled)
+{
+	chaptersOnly_ = enabled;
+}
+
+void DMX::setAnalyzeOnly(bool enabled)
+{
+	analyzeOnly_ = enabled;
+}
+
+void DMX::setChapterFormat(ChapterManager::Format format)
+{
+	chapterFormat_ = format;
+}
+
+void DMX::setDeterministicUIDs(bool enabled)
+{
+	deterministicUIDs_ = enabled;
+}
+
+void DMX::setMatroskaOutput(bool enabled)
+{
+	matroskaOutput_ = enabled;
+}
+
+void DMX::setBackgroundMux(bool enabled)
+{
+	backgroundMux_ = enabled;
+}
+
+void DMX::setLinkDuplicates(bool enabled)
+{
+	linkDuplicates_ = enabled;
+}
+
+void DMX::setAngle(unsigned int angle)
+{
+	angle_ = angle;
+}
+
+void DMX::setResync(bool enabled)
+{
+	resync_ = enabled;
+}
+
+void DMX::setMetricsFile(const QString& filename)
+{
+	metricsFile_ = filename;
+}
+
+QString DMX::passName(int16_t title, bool menu)
+{
+	if (title == 0)
+		return "VMG";
+
+	return QString("VTS%1%2").arg(menu ? "M" : "").arg(title, 2, 10, QChar('0'));
+}
+
+QByteArray DMX::passFingerprint(int16_t title, int selectionIndex) const
+{
+	QString selection ("all");
+
+	if (selectionIndex >= 0)
+	{
+		const DMXSelectionItem& item = selection_[selectionIndex];
+
+		selection = QString("%1,%2,%3,{").arg(item.title()).arg(item.isMenu()).arg(item.isVideoEnabled());
+		for (size_t index = 0; index < item.audioTracks().size(); ++index)
+			selection += QString(index ? ",%1" : "%1").arg(item.audioTracks()[index]);
+		selection += "},{";
+		for (size_t index = 0; index < item.subtitleTracks().size(); ++index)
+			selection += QString(index ? ",%1" : "%1").arg(item.subtitleTracks()[index]);
+		selection += "}";
+
+		// same syntax as the -s option of the console
+		if (!item.pgcs().empty())
+		{
+			selection += ",{";
+			for (size_t index = 0; index < item.pgcs().size(); ++index)
+			{
+				const PgcSelection& pgc = item.pgcs()[index];
+				selection += QString(index ? ",%1/%2:%3-%4" : "%1/%2:%3-%4").arg(pgc.languageUnit).arg(pgc.pgc).arg(pgc.firstCell).arg(pgc.lastCell);
+			}
+			selection += "}";
+		}
+	}
+
+	QCryptographicHash hash (QCryptographicHash::Md5);
+
+	hash.addData(discID_);
+	hash.addData(ifoFile_->InfoFileHash(title));
+	hash.addData(selection.toUtf8());
+	hash.addData(toolsPath_.toUtf8());
+	hash.addData(Utilities::APPLICATION_VERSION.toUtf8());
+
+	// a chapter-only pass does not produce the streams of a full one
+	if (chaptersOnly_)
+		hash.addData("chapters");
+	if (chapterFormat_ != ChapterManager::FORMAT_XML)
+		hash.addData("ebml");
+	if (angle_)
+		hash.addData(QString("angle%1").arg(angle_).toUtf8());
+	if (resync_)
+		hash.addData("resync");
+	if (matroskaOutput_)
+		hash.addData("mkv");
+	else if (backgroundMux_)
+		hash.addData("mux");
+
+	return hash.result();
+}
+
 void DMX::run()
 {
+	report_.start(sourcePath_);
+
 	// try to open input file
+	RunReport::StageTimer ifoTimer(report_, RunReport::STAGE_IFO_LOAD);
 	if (!sourcePath_.size() || !loadIFOFile(sourcePath_))
 		return;
+	ifoTimer.stop();
 
 	QMutex mutex;
 	mutex.lock();
 	needsAbort_ = false;
 	mutex.unlock();
 
+	manifest_.load(destinationPath_);
+	discID_ = ifoFile_->DiscID();
+	contentStore_.clear();
+	analysis_.start(sourcePath_);
+
+	if (!metricsFile_.isEmpty())
+	{
+		metrics_.abortLatency.store(-1);
+		metricsPublisher_ = new MetricsPublisher(metrics_, metricsFile_);
+		metricsPublisher_->start();
+	}
+
 	if (selection_.size()) // if selection is available
 	{
 		for (size_t index = 0; index < selection_.size(); ++index)
@@ -143,16 +355,30 @@ void DMX::run()
 		for (int16_t title = 0; title <= ifoFile_->NumberOfTitles(); ++title)
 			processTitle(title, -1);
 	}
+
+	finishMux();
+
+	if (analyzeOnly_)
+		analysis_.save(destinationPath_ + QDir::separator() + DiscAnalysis::FILENAME);
+
+	if (contentStore_.linkedBytes() > 0)
+		printf("Linked identical menu files, %lld bytes saved\n", (long long)contentStore_.linkedBytes());
+
+	report_.save(destinationPath_ + QDir::separator() + RunReport::FILENAME);
+
+	// publish the final values
+	delete metricsPublisher_;
+	metricsPublisher_ = 0;
 }
 
-IFOFile* DMX::OpenIFOFile(const QString& path)
+IFOFile* DMX::OpenIFOFile(const QString& path, IfoLoadMode mode)
 {
 	IFOFile *file = 0;
 	QDir info (path);
 	
 	try
 	{
-		file = new IFOFile(info.absolutePath());
+		file = new IFOFile(info.absolutePath(), mode, DiscCache::DefaultDirectory());
 	}
 	catch(IFOException&)
 	{
@@ -189,7 +415,7 @@ VobParser* DMX::buildVobParser(int16_t title, bool menu)
 	
 	try 
 	{
-		parser = new VobParser(qPrintable(sourcePath_), title, menu);
+		parser = new VobParser(qPrintable(sourcePath_), title, menu, ifoFile_);
 	} catch (...)
 	{
 		if (consoleMode_)
@@ -206,6 +432,99 @@ VobParser* DMX::buildVobParser(int16_t title, bool menu)
 	return parser;
 }
 
+void DMX::reportProgress(const ProgressMeter& progress, unsigned vob, unsigned cell)
+{
+	const QString details = progress.details(vob, cell);
+
+	if (consoleMode_)
+	{
+		printf("\r%3d%% %-60s", progress.percent(), qPrintable(details));
+		fflush(stdout);
+	}
+	else
+	{
+		emit progressChanged(progress.percent());
+		emit progressDetailsChanged(details);
+	}
+}
+
+void DMX::updateMetrics(const VobParser& parser)
+{
+	if (!metricsPublisher_)
+		return;
+
+	const CompositeDemuxWriter& demuxer = parser.GetDemuxer();
+
+	metrics_.vob.store(parser.GetVobID());
+	metrics_.cell.store(parser.GetCellID());
+	metrics_.sector.store(parser.GetPacketIndex());
+	metrics_.sectorsRead.store(parser.GetSectorsRead());
+
+	for (int streamID = 0; streamID < 256; ++streamID)
+		metrics_.streamBytes[streamID].store(demuxer.GetByteCount(streamID));
+
+	const Writer *video = demuxer.GetWriter(VIDEO_STREAM);
+	metrics_.videoBufferBytes.store(video ? video->GetBufferedBytes() : 0);
+}
+
+void DMX::startMux(const QString& name, const QByteArray& fingerprint, const QStringList& files)
+{
+	// one mkvmerge at a time, it shares the disk with the demuxer
+	finishMux();
+
+	// demux() writes the script last
+	muxJob_ = new MuxJob(name, fingerprint, files, destinationPath_ + QDir::separator() + name + ".mkv");
+
+	if (muxJob_->start())
+		printf("Muxing %s in the background\n", qPrintable(name));
+	else
+	{
+		delete muxJob_;
+		muxJob_ = 0;
+	}
+}
+
+void DMX::finishMux()
+{
+	if (!muxJob_)
+		return;
+
+	if (needsAbort_)
+	{
+		muxJob_->kill();
+		manifest_.remove(muxJob_->name());
+		manifest_.save();
+	}
+	else
+	{
+		RunReport::StageTimer muxTimer(report_, RunReport::STAGE_MUX_WAIT);
+		const bool muxed = muxJob_->wait();
+		muxTimer.stop();
+
+		if (muxed)
+		{
+			// the .mkv is the only output left for the manifest, a damaged
+			// pass has no fingerprint and stays out of it
+			muxJob_->removeIntermediateFiles();
+			if (!muxJob_->fingerprint().isEmpty())
+				manifest_.update(muxJob_->name(), muxJob_->fingerprint(), QStringList(muxJob_->outputFile()));
+			manifest_.save();
+
+			printf("Done muxing %s\n", qPrintable(muxJob_->name()));
+		}
+		else
+		{
+			manifest_.remove(muxJob_->name());
+			manifest_.save();
+
+			fprintf(stderr, "mkvmerge failed on %s, the script and its files are kept\n", qPrintable(muxJob_->name()));
+		}
+	}
+
+	delete muxJob_;
+	muxJob_ = 0;
+}
+
 void DMX::demuxAudioTrack(int16_t title, bool isMenu, const AudioTrackList& _audioTracks, size_t _stream, CompositeDemuxWriter& demuxer, const QString& filename)
 {
 	if (_stream < 0 || _stream >= _audioTracks.size())
@@ -229,6 +548,40 @@ void DMX::demuxAudioTrack(int16_t title, bool isMenu, const AudioTrackList& _aud
 		langSuffix = QString("_%1_%2%3").arg(QString::number(_ID), QString(_attr->lang_code >> 8), QString(_attr->lang_code & 0xFF));
 	}
 
+	// the built-in muxer gets a track instead of a writer
+	MatroskaMuxer *matroska = demuxer.GetMatroskaMuxer();
+	if (matroska)
+	{
+		const QString trackName ("aud-" + filename + langSuffix);
+		const uint32_t sampleRate = _attr->sample_frequency ? 96000 : 48000;
+		const uint8_t channels = _attr->channels + 1;
+
+		switch (_attr->audio_format)
+		{
+		case 0:
+			matroska->AddAudioTrack(SUBSTREAM_AC3_LOW + _ID, MatroskaMuxer::TRACK_AC3, trackName, _attr->lang_code, sampleRate, channels);
+			break;
+
+		case 2:
+		case 3:
+			matroska->AddAudioTrack(AUDIO_STREAM + _ID, MatroskaMuxer::TRACK_MPA, trackName, _attr->lang_code, sampleRate, channels);
+			break;
+
+		case 4:
+			// same format as the WAV writer
+			matroska->AddAudioTrack(SUBSTREAM_PCM_LOW + _ID, MatroskaMuxer::TRACK_LPCM, trackName, _attr->lang_code, 48000, 2);
+			break;
+
+		case 6:
+			matroska->AddAudioTrack(SUBSTREAM_DTS_LOW + _ID, MatroskaMuxer::TRACK_DTS, trackName, _attr->lang_code, sampleRate, channels);
+			break;
+
+		default:
+			fprintf(stderr, "Unknown Audio Format: %d\n", _attr->audio_format);
+		}
+		return;
+	}
+
 	QString muxArguments;
 	QString fullPrefix (destinationPath_ + QDir::separator() + filename + langSuffix);
 
@@ -287,6 +640,7 @@ void DMX::demuxSubtitleTrack(int16_t title, bool isMenu, const SubtitleTrackList
 	IdArray _IDs = ifoFile_->GetSubsId(_stream, title, isMenu);
 
 	Writer * _muxer = 0;
+	MatroskaMuxer *matroska = demuxer.GetMatroskaMuxer();
 	QString lang, langSuffix;
 	
 	for (IdArray::size_type _IDidx=0; _IDidx < _IDs.size(); ++_IDidx)
@@ -303,6 +657,12 @@ void DMX::demuxSubtitleTrack(int16_t title, bool isMenu, const SubtitleTrackList
 			langSuffix = QString("_%1_%2%3").arg(QString::number(_IDs.at(_IDidx)), QString(_attr->lang_code >> 8), QString(_attr->lang_code & 0xFF));		
 		}
 
+		if (matroska)
+		{
+			matroska->AddSubtitleTrack(SUBSTREAM_SUB_LOW + _IDs.at(_IDidx), "sub-" + filename + langSuffix, _attr->lang_code, _width, _height, _palette);
+			continue;
+		}
+
 		_muxer = new SubDemuxWriter(QString(prefix + langSuffix), 0x20 + _IDs.at(_IDidx), _width, _height, _palette, _attr->lang_code, _attr->lang_extension == 9);
 
 		QString commandLine = subMuxArgumentsFormat.arg(filename + langSuffix, lang, prefix + langSuffix + ".idx");
@@ -311,33 +671,34 @@ void DMX::demuxSubtitleTrack(int16_t title, bool isMenu, const SubtitleTrackList
 	}
 }
 
-void DMX::demux(VobParser *aVobParser, int selectionIndex, const QString &editionUID, int16_t title, bool menu)
+bool DMX::demux(VobParser *aVobParser, int selectionIndex, const QString &editionUID, int16_t title, bool menu, QStringList& outputFiles)
 {
 	// get list of all cells
 	const CellsListType *CellsList = ifoFile_->GetCellsList(title, menu);
 	
 	if (!CellsList)
-		return;
+		return false;
 
 	static const QString demuxArguments (" --track-name 0:\"video\" --timecodes 0:\"%1_m2v.tmc\" \"%1.m2v\"");
 	static const QString btnMuxArgumentsFormat(" --track-name 0:\"btn-%1\" --timecodes 0:\"%2_btn.tmc\" \"%2.btn\"");
 	
 	try
 	{
-		QString filename;
 		QString muxCommand;
-
-		// init filename
-		if (title == 0)
-			filename = "VMG";
-		else
-			filename = QString("VTS%1%2").arg(menu ? "M" : "").arg(title, 2, 10, QChar('0'));
+		const QString filename = passName(title, menu);
 
 		const QString prefix = destinationPath_ + QDir::separator() + filename;
 
+		// the built-in muxer replaces the writers and the mkvmerge script
+		QScopedPointer<MatroskaMuxer> matroska (matroskaOutput_ ? new MatroskaMuxer(prefix + ".mkv", Utilities::APPLICATION_NAME + " " + Utilities::APPLICATION_VERSION) : 0);
+
 		if (aVobParser != 0)
 		{
 			aVobParser->Reset();
+			// the cells no PGC plays are never read
+			aVobParser->SetReadPlan(CellsList->GetReadPlan());
+			aVobParser->SetSingleAngle(angle_ != 0);
+			aVobParser->SetResync(resync_);
 
 			const AudioTrackList & _audioTracks = ifoFile_->AudioTracks(title, menu);
 			const SubtitleTrackList & _subTracks = ifoFile_->SubsTracks(title, menu);
@@ -353,15 +714,21 @@ void DMX::demux(VobParser *aVobParser, int selectionIndex, const QString &editio
 			//emit progressChanged(CellsList->count());
 
 			demuxer.Reset();
+			demuxer.SetMatroskaMuxer(matroska.data());
 			printf("Processing %s\n", qPrintable(filename));
 
 			if ((selectionIndex < 0) || (selection_[selectionIndex].isVideoEnabled()))
 			{
-				Writer *_muxer = new VideoDemuxWriter(prefix, _fps);
+				if (matroska)
+					matroska->AddVideoTrack(VIDEO_STREAM, _width, _height, _fps);
+				else
+				{
+					Writer *_muxer = new VideoDemuxWriter(prefix, _fps);
 
-				QString commandLine = demuxArguments.arg(prefix);
-				if (!demuxer.AddDemuxer(VIDEO_STREAM, _muxer, commandLine))
-					delete _muxer;
+					QString commandLine = demuxArguments.arg(prefix);
+					if (!demuxer.AddDemuxer(VIDEO_STREAM, _muxer, commandLine))
+						delete _muxer;
+				}
 			}
 
 			size_t _stream = 0;
@@ -409,29 +776,86 @@ void DMX::demux(VobParser *aVobParser, int selectionIndex, const QString &editio
 				}
 
 				// create a possible button demuxer too
-				Writer *_muxer = new BtnDemuxWriter(prefix, _width, _height);
+				if (matroska)
+					matroska->AddButtonTrack(SUBSTREAM_PCI, "btn-" + filename, _width, _height);
+				else
+				{
+					Writer *_muxer = new BtnDemuxWriter(prefix, _width, _height);
 
-				QString commandLine = btnMuxArgumentsFormat.arg(filename, prefix);
-				if (!demuxer.AddDemuxer(SUBSTREAM_PCI, _muxer, commandLine))
-					delete _muxer;
+					QString commandLine = btnMuxArgumentsFormat.arg(filename, prefix);
+					if (!demuxer.AddDemuxer(SUBSTREAM_PCI, _muxer, commandLine))
+						delete _muxer;
+				}
 			}
 
+			CheckpointJournal journal(prefix, passFingerprint(title, selectionIndex));
+
+			// the muxer cannot restart a file from a checkpoint
+			if (resumeEnabled_ && !matroska && journal.restore(*aVobParser, *CellsList))
+				printf("Resuming %s at sector %u\n", qPrintable(filename), aVobParser->GetPacketIndex());
+
 			if (consoleMode_)
 				printf("0%%");
 			else
 				emit progressChanged(0);
 			
-			const uint32_t maximum = aVobParser->GetPacketCount();
+			// the progress counts the sectors read out of the ones of the plan, a
+			// resumed pass starts with the planned sectors before its position
+			const uint32_t plannedSectors = aVobParser->GetPlannedSectors();
+			const uint32_t doneBefore = aVobParser->GetPlannedSectors(aVobParser->GetPacketIndex());
+			const uint32_t readBefore = aVobParser->GetSectorsRead();
+			ProgressMeter progress(plannedSectors, doneBefore);
+			uint32_t nextCheck = progress.nextCheck();
+
+			metrics_.title.store(title);
+			metrics_.menu.store(menu);
+			metrics_.sectorCount.store(plannedSectors);
+			updateMetrics(*aVobParser);
+
+			RunReport::StageTimer demuxTimer(report_, RunReport::STAGE_DEMUX);
 			
 			while(aVobParser->ParseNextPacket(*CellsList) && !needsAbort_)
 			{
-				if (consoleMode_)
-					printf("\r\r\r%d%%", aVobParser->GetPacketIndex() * 100 / maximum);
-				else
-					emit progressChanged(aVobParser->GetPacketIndex() * 100 / maximum);
+				// cell boundaries are the only places where every writer can be restarted
+				if (aVobParser->IsCellStart() && !matroska && journal.isDue(aVobParser->GetPacketIndex()))
+					journal.save(*aVobParser, *CellsList);
+
+				if (doneBefore + aVobParser->GetSectorsRead() - readBefore < nextCheck)
+					continue;
+
+				updateMetrics(*aVobParser);
+
+				if (progress.update(doneBefore + aVobParser->GetSectorsRead() - readBefore))
+					reportProgress(progress, aVobParser->GetVobID(), aVobParser->GetCellID());
+
+				nextCheck = progress.nextCheck();
 			}
+
+			const qint64 demuxTime = demuxTimer.stop();
+
+			updateMetrics(*aVobParser);
+			if (needsAbort_)
+				metrics_.abortLatency.store(abortTimer_.elapsed());
+
+			// the interleaved units of the other angles were in the plan but not read
+			progress.update(needsAbort_ ? doneBefore + aVobParser->GetSectorsRead() - readBefore : plannedSectors);
+			reportProgress(progress, aVobParser->GetVobID(), aVobParser->GetCellID());
 			printf("\n");
 
+			const std::vector<SectorExtent>& skipped = aVobParser->GetSkippedSectors();
+			if (!skipped.empty())
+			{
+				uint32_t skippedCount = 0;
+				for (size_t index = 0; index < skipped.size(); ++index)
+					skippedCount += skipped[index].last - skipped[index].first + 1;
+
+				printf("Skipped %u damaged sector(s) in %u range(s) of %s\n", skippedCount, unsigned(skipped.size()), qPrintable(filename));
+			}
+
+			// keep the checkpoint of an aborted pass for the next run
+			if (!needsAbort_)
+				journal.remove();
+
 			// create the command line using the list of used files
 			// always put video first
 			if (demuxer.FileExists(VIDEO_STREAM))
@@ -445,20 +869,48 @@ void DMX::demux(VobParser *aVobParser, int selectionIndex, const QString &editio
 				if (demuxer.FileExists(_stream))
 					muxCommand += demuxer.GetString(_stream);
 			}
+
+			// close the outputs so their final size is known
+			const QStringList writerFiles = demuxer.GetOutputFiles();
+			outputFiles += writerFiles;
+
+			RunReport::StageTimer flushTimer(report_, RunReport::STAGE_WRITER_FLUSH);
+			demuxer.Reset();
+			flushTimer.stop();
+
+			// the menus of the title sets often repeat the same backgrounds and buttons
+			if (linkDuplicates_ && menu && !needsAbort_)
+			{
+				for (int index = 0; index < writerFiles.size(); ++index)
+				{
+					const QString target = contentStore_.add(writerFiles.at(index));
+					if (!target.isEmpty())
+						printf("Linked %s to %s\n", qPrintable(QFileInfo(writerFiles.at(index)).fileName()), qPrintable(QFileInfo(target).fileName()));
+				}
+			}
+
+			report_.addPass(filename, *aVobParser, demuxTime);
 		}
 
-		CellsListType *CellsListDone = (CellsListType *)CellsList;
-		CellsListDone->arrange();
+		if (matroska)
+		{
+			// the chapters are embedded, nothing is left for mkvmerge
+			embedChapters(*matroska, title, menu, editionUID);
 
-		bool addChapters = false;
-		ChapterManager chapterEditor(2 /*indent count*/);
+			if (!matroska->Finish())
+			{
+				fprintf(stderr, "Could not write %s\n", qPrintable(matroska->GetFilename()));
+				return false;
+			}
 
-		if (menu)
-			addChapters = chapterEditor.generateMenuScript(*ifoFile_, prefix, title, editionUID);
-		else
-			addChapters = chapterEditor.generateScript(*ifoFile_, prefix, title, editionUID);
+			outputFiles.append(matroska->GetFilename());
+			printf("Done muxing %s\n", qPrintable(filename));
 
-		if (addChapters)
+			return !needsAbort_;
+		}
+
+		// mkvmerge only reads the XML chapters
+		if (writeChapters(title, menu, editionUID, outputFiles, chapterFormat_) && chapterFormat_ == ChapterManager::FORMAT_XML)
 		{
 			muxCommand += " --chapters \"" + prefix + ChapterManager::CHAPTER_SUFFIX + "\"";
 			muxCommand += " --segmentinfo \"" + prefix + ChapterManager::INFO_SUFFIX + "\"";
@@ -481,11 +933,133 @@ void DMX::demux(VobParser *aVobParser, int selectionIndex, const QString &editio
 #endif
 		muxBatchFile.write(muxCommand.toUtf8());
 		muxBatchFile.close();
+		outputFiles.append(muxBatchFile.fileName());
 
 		printf("Done demuxing %s\n", qPrintable(filename));
 	}
 	catch(VobParserException e)
+	{
+		// the muxer of the pass is already destroyed, the parser must not flush it
+		if (aVobParser != 0)
+			aVobParser->GetDemuxer().SetMatroskaMuxer(0);
+
+		fprintf(stderr, "Vob Parser Exception Occurred: %s\n", e.what());
+		return false;
+	}
+
+	return !needsAbort_;
+}
+
+bool DMX::writeChapters(int16_t title, bool menu, const QString& editionUID, QStringList& outputFiles, ChapterManager::Format format)
+{
+	CellsListType *CellsListDone = (CellsListType *)ifoFile_->GetCellsList(title, menu);
+	if (!CellsListDone)
+		return false;
+
+	CellsListDone->arrange();
+
+	const QString prefix = destinationPath_ + QDir::separator() + passName(title, menu);
+
+	bool addChapters = false;
+	ChapterManager chapterEditor(2 /*indent count*/, format);
+
+	RunReport::StageTimer chaptersTimer(report_, RunReport::STAGE_CHAPTERS);
+	if (menu)
+		addChapters = chapterEditor.generateMenuScript(*ifoFile_, prefix, title, editionUID);
+	else
+		addChapters = chapterEditor.generateScript(*ifoFile_, prefix, title, editionUID);
+	chaptersTimer.stop();
+
+	if (addChapters)
+	{
+		outputFiles.append(prefix + chapterEditor.chapterSuffix());
+		outputFiles.append(prefix + chapterEditor.infoSuffix());
+	}
+
+	return addChapters;
+}
+
+void DMX::embedChapters(MatroskaMuxer& matroska, int16_t title, bool menu, const QString& editionUID)
+{
+	const QString prefix = destinationPath_ + QDir::separator() + passName(title, menu);
+	QStringList chapterFiles;
+
+	// the EBML elements go through temporary files, like the ones given to mkvmerge
+	if (writeChapters(title, menu, editionUID, chapterFiles, ChapterManager::FORMAT_EBML))
+	{
+		QFile chapterFile (prefix + ChapterManager::EBML_CHAPTER_SUFFIX);
+		if (chapterFile.open(QIODevice::ReadOnly))
+			matroska.SetChapters(chapterFile.readAll());
+
+		// derived from the edition UID so it is reproducible with it
+		const QByteArray segmentUID = QCryptographicHash::hash((editionUID + prefix).toUtf8(), QCryptographicHash::Md5);
+
+		QFile infoFile (prefix + ChapterManager::EBML_INFO_SUFFIX);
+		if (infoFile.open(QIODevice::ReadOnly))
+			matroska.SetSegmentInfo(segmentUID, infoFile.readAll());
+	}
+
+	QFile::remove(prefix + ChapterManager::EBML_CHAPTER_SUFFIX);
+	QFile::remove(prefix + ChapterManager::EBML_INFO_SUFFIX);
+}
+
+bool DMX::extractChapters(int16_t title, bool menu, const QString& editionUID, QStringList& outputFiles)
+{
+	const QString filename = passName(title, menu);
+
+	// the cells present on the disc are found from the IFO and a single sector per cell
+	RunReport::StageTimer vobMapTimer(report_, RunReport::STAGE_VOB_MAP);
+	const size_t found = ifoFile_->FindCells(title, menu);
+	vobMapTimer.stop();
+
+	if (!found)
+		printf("No cell found in %s VOB file(s)\n", qPrintable(filename));
+
+	writeChapters(title, menu, editionUID, outputFiles, chapterFormat_);
+
+	printf("Done extracting chapters of %s\n", qPrintable(filename));
+
+	return !needsAbort_;
+}
+
+bool DMX::analyze(int16_t title, bool menu)
+{
+	const QString name = passName(title, menu);
+
+	VobParser *aVobParser = buildVobParser(title, menu);
+	if (!aVobParser)
+		return false;
+
+	printf("Analyzing %s\n", qPrintable(name));
+
+	try
+	{
+		analysis_.beginPass(name, *ifoFile_, title, menu);
+
+		ProgressMeter progress(aVobParser->GetPacketCount());
+		int64_t sector;
+
+		while (!needsAbort_ && (sector = aVobParser->ParseNextVOBU()) >= 0)
+		{
+			analysis_.addVOBU(*aVobParser, sector);
+
+			if (progress.update(aVobParser->GetPacketIndex()))
+				reportProgress(progress, aVobParser->GetVobID(), aVobParser->GetCellID());
+		}
+
+		progress.update(aVobParser->GetPacketCount());
+		reportProgress(progress, aVobParser->GetVobID(), aVobParser->GetCellID());
+		printf("\n");
+
+		analysis_.endPass(*aVobParser);
+	}
+	catch(VobParserException e)
 	{
 		fprintf(stderr, "Vob Parser Exception Occurred: %s\n", e.what());
+		delete aVobParser;
+		return false;
 	}
+
+	delete aVobParser;
+	return !needsAbort_;
 }
@@ -4,8 +4,18 @@
 #include <vector>
 #include <QThread>
 #include "dmxselectionitem.h"
+#include "extractionmanifest.h"
+#include "runreport.h"
+#include "discanalysis.h"
+#include "livemetrics.h"
+#include "chaptermanager.h"
+#include "contentstore.h"
 #include "vobparser/IFOFile.h"
 
+class ProgressMeter;
+class MatroskaMuxer;
+class MuxJob;
+
 class DMX : public QThread
 {
 	Q_OBJECT
@@ -16,8 +26,48 @@ public:
   DMX(bool consoleMode = false);
   ~DMX();
 
-	static IFOFile* OpenIFOFile(const QString& path);
+	static IFOFile* OpenIFOFile(const QString& path, IfoLoadMode mode = IFO_LOAD_LAZY);
 	bool setExtractionParameters(const QString& sourcePath, const QString& destinationPath, const QString& toolsPath, const SelectionType& selection);
+
+	// Resume titles from the checkpoint left by an interrupted extraction
+	void setResumeEnabled(bool enabled);
+
+	// Skip titles whose outputs listed in the manifest are still up to date, off by default
+	void setSkipUpToDate(bool enabled);
+
+	// Only write the chapters and segment info, the VOB files are not demuxed
+	void setChaptersOnly(bool enabled);
+
+	// Only read the navigation pack of each VOBU and write an inventory of the
+	// disc to dmx_analysis.json, nothing is demuxed
+	void setAnalyzeOnly(bool enabled);
+
+	// Write the chapters and segment info as XML for mkvmerge or as binary EBML elements
+	void setChapterFormat(ChapterManager::Format format);
+
+	// Generate the same chapter and edition UIDs on each run of the same disc
+	void setDeterministicUIDs(bool enabled);
+
+	// Write each title to a .mkv with the built-in muxer instead of demuxed files and a mkvmerge script
+	void setMatroskaOutput(bool enabled);
+
+	// Run the mkvmerge script of each title while the next one is demuxed, the
+	// demuxed files are deleted once the .mkv is written
+	void setBackgroundMux(bool enabled);
+
+	// Replace the demuxed menu files identical to the ones of an earlier menu
+	// with hard links to them
+	void setLinkDuplicates(bool enabled);
+
+	// Demux only the given angle (from 1) of the multi-angle titles, 0 keeps them all
+	void setAngle(unsigned int angle);
+
+	// Skip the damaged sectors up to the next pack start instead of aborting the
+	// title, the skipped ranges are listed in the run report
+	void setResync(bool enabled);
+
+	// Publish live counters to a Prometheus text file, rewritten every second
+	void setMetricsFile(const QString& filename);
 	
 signals:
 	// Signal is emitted when the current step progress is changed
@@ -26,6 +76,9 @@ signals:
 	// Signal is emitted when the step is changed
 	void stepChanged(const QString&);
 
+	// Signal is emitted with the rate, remaining time and position of the current step
+	void progressDetailsChanged(const QString&);
+
 public slots:
 	void abort();
 
@@ -40,13 +93,45 @@ private:
 	QString destinationPath_;
 	SelectionType selection_;
 	volatile bool needsAbort_;
+	bool resumeEnabled_;
+	bool skipUpToDate_;
+	bool chaptersOnly_;
+	bool analyzeOnly_;
+	ChapterManager::Format chapterFormat_;
+	bool deterministicUIDs_;
+	bool matroskaOutput_;
+	bool backgroundMux_;
+	bool linkDuplicates_;
+	unsigned int angle_;
+	bool resync_;
+	MuxJob *muxJob_;
+	ExtractionManifest manifest_;
+	ContentStore contentStore_;
+	QByteArray discID_;
+	RunReport report_;
+	DiscAnalysis analysis_;
+	QString metricsFile_;
+	LiveMetrics metrics_;
+	MetricsPublisher *metricsPublisher_;
+	QElapsedTimer abortTimer_;
 	
 	bool loadIFOFile(const QString& path);
 	void processTitle(int16_t title, int index);
 
+	static QString passName(int16_t title, bool isMenu);
+	QByteArray passFingerprint(int16_t title, int selectionIndex) const;
+
 	VobParser* buildVobParser(int16_t title, bool isMenu);
+	void reportProgress(const ProgressMeter& progress, unsigned vob, unsigned cell);
+	void updateMetrics(const VobParser& parser);
+	void startMux(const QString& name, const QByteArray& fingerprint, const QStringList& files);
+	void finishMux();
 	
-	void demux(VobParser* aVobParser, int selectionIndex, const QString& editionUID, int16_t title, bool isMenu);
+	bool demux(VobParser* aVobParser, int selectionIndex, const QString& editionUID, int16_t title, bool isMenu, QStringList& outputFiles);
+	bool writeChapters(int16_t title, bool isMenu, const QString& editionUID, QStringList& outputFiles, ChapterManager::Format format);
+	void embedChapters(MatroskaMuxer& matroska, int16_t title, bool isMenu, const QString& editionUID);
+	bool extractChapters(int16_t title, bool isMenu, const QString& editionUID, QStringList& outputFiles);
+	bool analyze(int16_t title, bool isMenu);
 	void demuxAudioTrack(int16_t title, bool isMenu, const AudioTrackList& _audioTracks, size_t _stream, CompositeDemuxWriter& demuxer, const QString& filename);
 	void demuxSubtitleTrack(int16_t title, bool isMenu, const SubtitleTrackList& _subTracks, size_t _stream,  CompositeDemuxWriter& demuxer, const QString& filename, const uint32_t *_palette, uint16_t _width, uint16_t _height);
 };
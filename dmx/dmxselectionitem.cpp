@@ -38,6 +38,11 @@ const DMXSelectionItem::TracksContainerType& DMXSelectionItem::subtitleTracks()
 	return subtitleTracks_;
 }
 
+const PgcSelectionList& DMXSelectionItem::pgcs() const
+{
+	return pgcs_;
+}
+
 void DMXSelectionItem::disableVideo()
 {
 	videoEnabled_ = false;
@@ -66,3 +71,14 @@ bool DMXSelectionItem::addSubtitleTrack(size_t trackIndex)
 
 	return false;
 }
+
+void DMXSelectionItem::addPgc(uint16_t languageUnit, uint16_t pgc, uint16_t firstCell, uint16_t lastCell)
+{
+	PgcSelection selection;
+	selection.languageUnit = languageUnit;
+	selection.pgc = pgc;
+	selection.firstCell = firstCell;
+	selection.lastCell = lastCell;
+
+	pgcs_.push_back(selection);
+}
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <stdint.h>
+#include "vobparser/IFOFile.h"
 
 // Denotes each selected title
 class DMXSelectionItem
@@ -20,10 +21,13 @@ public:
 	bool isVideoEnabled() const;
 	const TracksContainerType& audioTracks() const;
 	const TracksContainerType& subtitleTracks() const;
+	// PGCs and cells to process, all of them when empty
+	const PgcSelectionList& pgcs() const;
 
 	void disableVideo();
 	bool addAudioTrack(size_t trackIndex);
 	bool addSubtitleTrack(size_t trackIndex);
+	void addPgc(uint16_t languageUnit, uint16_t pgc, uint16_t firstCell, uint16_t lastCell);
 
 private:
 	int16_t title_;
@@ -32,6 +36,7 @@ private:
 
 	TracksContainerType audioTracks_;
 	TracksContainerType subtitleTracks_;
+	PgcSelectionList pgcs_;
 };
 
 
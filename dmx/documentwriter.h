@@ -0,0 +1,27 @@
+#ifndef DOCUMENT_WRITER_H
+#define DOCUMENT_WRITER_H
+
+#include <QString>
+
+// Output of a tree of named elements written in document order,
+// ChapterManager uses it for both its XML and EBML files
+class DocumentWriter
+{
+public:
+	virtual ~DocumentWriter() {}
+
+	virtual void writeStartDocument(const QString& docType, const QString& systemId) = 0;
+	// close the open elements and write what is left in the buffer
+	virtual bool writeEndDocument() = 0;
+
+	virtual void writeStartElement(const QString& name) = 0;
+	virtual void writeEndElement() = 0;
+
+	// element with a text content only, optionally with one attribute
+	virtual void writeTextElement(const QString& name, const QString& text) = 0;
+	virtual void writeTextElement(const QString& name, const QString& text, const QString& attribute, const QString& value) = 0;
+
+	virtual void writeComment(const QString& text) = 0;
+};
+
+#endif // DOCUMENT_WRITER_H
@@ -0,0 +1,243 @@
+#include "ebmlwriter.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <QIODevice>
+#include <QStringList>
+
+// size field of the master elements: 8 bytes length marker, patched at the end of the element
+static const int MASTER_SIZE_LENGTH = 8;
+
+const EbmlWriter::Element EbmlWriter::ELEMENTS[] =
+{
+	{"Chapters",                   0x1043A770, TYPE_MASTER},
+	{"EditionEntry",               0x45B9,     TYPE_MASTER},
+	{"EditionUID",                 0x45BC,     TYPE_UINT},
+	{"EditionFlagOrdered",         0x45DD,     TYPE_UINT},
+	{"ChapterAtom",                0xB6,       TYPE_MASTER},
+	{"ChapterUID",                 0x73C4,     TYPE_UINT},
+	{"ChapterFlagHidden",          0x98,       TYPE_UINT},
+	{"ChapterTimeStart",           0x91,       TYPE_TIME},
+	{"ChapterTimeEnd",             0x92,       TYPE_TIME},
+	{"ChapterDisplay",             0x80,       TYPE_MASTER},
+	{"ChapterString",              0x85,       TYPE_UTF8},
+	{"ChapterProcess",             0x6944,     TYPE_MASTER},
+	{"ChapterProcessCodecID",      0x6955,     TYPE_UINT},
+	{"ChapterProcessPrivate",      0x450D,     TYPE_BINARY},
+	{"ChapterProcessCommand",      0x6911,     TYPE_MASTER},
+	{"ChapterProcessTime",         0x6922,     TYPE_UINT},
+	{"ChapterProcessData",         0x6933,     TYPE_BINARY},
+	{"Info",                       0x1549A966, TYPE_MASTER},
+	{"SegmentFamily",              0x4444,     TYPE_BINARY},
+	{"ChapterTranslate",           0x6924,     TYPE_MASTER},
+	{"ChapterTranslateEditionUID", 0x69FC,     TYPE_UINT},
+	{"ChapterTranslateCodec",      0x69BF,     TYPE_UINT},
+	{"ChapterTranslateID",         0x69A5,     TYPE_BINARY},
+	{0, 0, TYPE_MASTER}
+};
+
+EbmlWriter::EbmlWriter(QIODevice *device)
+	: device_(device), flushed_(0), failed_(false)
+{
+	// keep the allocation between flushes
+	buffer_.reserve(BUFFER_SIZE);
+}
+
+EbmlWriter::~EbmlWriter()
+{
+	flush();
+}
+
+const EbmlWriter::Element* EbmlWriter::FindElement(const QString& name)
+{
+	for (const Element *element = ELEMENTS; element->name; ++element)
+	{
+		if (name == element->name)
+			return element;
+	}
+
+	fprintf(stderr, "No EBML ID for the element '%s'\n", qPrintable(name));
+	return 0;
+}
+
+void EbmlWriter::writeStartDocument(const QString&, const QString&)
+{
+}
+
+bool EbmlWriter::writeEndDocument()
+{
+	while (!masters_.empty())
+		writeEndElement();
+
+	return flush() && !failed_;
+}
+
+void EbmlWriter::writeStartElement(const QString& name)
+{
+	const Element *element = FindElement(name);
+
+	if (!element || element->type != TYPE_MASTER)
+	{
+		failed_ = true;
+		masters_.push_back(-1);
+		return;
+	}
+
+	appendId(buffer_, element->id);
+	masters_.push_back(position());
+	buffer_.append(QByteArray(MASTER_SIZE_LENGTH, '\0'));
+}
+
+void EbmlWriter::writeEndElement()
+{
+	if (masters_.empty())
+		return;
+
+	const qint64 sizePosition = masters_.back();
+	masters_.pop_back();
+
+	if (sizePosition >= 0)
+		patchSize(sizePosition, position() - sizePosition - MASTER_SIZE_LENGTH);
+
+	if (buffer_.size() >= BUFFER_SIZE)
+		flush();
+}
+
+void EbmlWriter::writeTextElement(const QString& name, const QString& text)
+{
+	writeTextElement(name, text, QString(), QString());
+}
+
+void EbmlWriter::writeTextElement(const QString& name, const QString& text, const QString& attribute, const QString& value)
+{
+	const Element *element = FindElement(name);
+
+	if (!element || element->type == TYPE_MASTER)
+	{
+		failed_ = true;
+		return;
+	}
+
+	QByteArray data;
+	uint64_t number = 0;
+
+	switch (element->type)
+	{
+	case TYPE_UINT:
+		number = text.toULongLong();
+		break;
+
+	case TYPE_TIME:
+		{
+			// HH:MM:SS.nnnnnnnnn as written by Utilities::FormatTime
+			const QStringList parts = text.split(':');
+			if (parts.size() == 3)
+			{
+				const QStringList seconds = parts.at(2).split('.');
+				number = (parts.at(0).toULongLong() * 3600 + parts.at(1).toULongLong() * 60 + seconds.at(0).toULongLong()) * 1000000000;
+				if (seconds.size() > 1)
+					number += seconds.at(1).toULongLong();
+			}
+		}
+		break;
+
+	case TYPE_BINARY:
+		if (attribute == "format" && value == "hex")
+			data = QByteArray::fromHex(text.toLatin1());
+		else
+			data = text.toUtf8();
+		break;
+
+	default:
+		data = text.toUtf8();
+		break;
+	}
+
+	if (element->type == TYPE_UINT || element->type == TYPE_TIME)
+	{
+		// big endian on the fewest bytes, at least one
+		do
+		{
+			data.prepend(char(number & 0xFF));
+			number >>= 8;
+		} while (number);
+	}
+
+	writeData(element->id, data);
+}
+
+void EbmlWriter::writeComment(const QString&)
+{
+}
+
+void EbmlWriter::appendId(QByteArray& out, uint32_t id)
+{
+	// the IDs keep their length marker, only the leading zero bytes are dropped
+	for (int shift = (id > 0xFFFFFF) ? 24 : (id > 0xFFFF) ? 16 : (id > 0xFF) ? 8 : 0; shift >= 0; shift -= 8)
+		out.append(char((id >> shift) & 0xFF));
+}
+
+void EbmlWriter::appendSize(QByteArray& out, uint64_t size, int length)
+{
+	// all ones are reserved for the unknown size
+	if (length == 0)
+	{
+		length = 1;
+		while (length < 8 && size >= (uint64_t(1) << (7 * length)) - 1)
+			length++;
+	}
+
+	const uint64_t coded = size | (uint64_t(1) << (7 * length));
+	for (int index = length - 1; index >= 0; index--)
+		out.append(char((coded >> (8 * index)) & 0xFF));
+}
+
+void EbmlWriter::writeData(uint32_t id, const QByteArray& data)
+{
+	appendId(buffer_, id);
+	appendSize(buffer_, data.size());
+	buffer_.append(data);
+
+	if (buffer_.size() >= BUFFER_SIZE)
+		flush();
+}
+
+void EbmlWriter::patchSize(qint64 sizePosition, uint64_t size)
+{
+	char field[MASTER_SIZE_LENGTH];
+
+	// 8 bytes length marker then 7 bytes of size
+	field[0] = 0x01;
+	for (int index = 1; index < MASTER_SIZE_LENGTH; index++)
+		field[index] = char((size >> (8 * (MASTER_SIZE_LENGTH - 1 - index))) & 0xFF);
+
+	if (sizePosition >= flushed_)
+	{
+		memcpy(buffer_.data() + (sizePosition - flushed_), field, MASTER_SIZE_LENGTH);
+		return;
+	}
+
+	// the start of the element is already in the file
+	flush();
+
+	if (!device_->seek(sizePosition) || device_->write(field, MASTER_SIZE_LENGTH) != MASTER_SIZE_LENGTH || !device_->seek(flushed_))
+		failed_ = true;
+}
+
+qint64 EbmlWriter::position() const
+{
+	return flushed_ + buffer_.size();
+}
+
+bool EbmlWriter::flush()
+{
+	if (buffer_.isEmpty())
+		return true;
+
+	if (device_->write(buffer_) != buffer_.size())
+		failed_ = true;
+
+	flushed_ += buffer_.size();
+	buffer_.resize(0);
+	return !failed_;
+}
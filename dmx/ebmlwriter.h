@@ -0,0 +1,69 @@
+#ifndef EBML_WRITER_H
+#define EBML_WRITER_H
+
+#include <vector>
+#include <stdint.h>
+#include <QByteArray>
+#include "documentwriter.h"
+
+class QIODevice;
+
+// Writes the Matroska Chapters and Info elements in binary, from the same calls
+// as XmlWriter. The element names are the ones of the mkvmerge XML files, the
+// text contents are converted to the type of each element. Only the top level
+// element is written, without EBML header, so a muxer can embed it as it is.
+// The device must be seekable, the sizes of the master elements are written last.
+class EbmlWriter : public DocumentWriter
+{
+public:
+	EbmlWriter(QIODevice *device);
+	~EbmlWriter();
+
+	// nothing to write, there is no document type in EBML
+	void writeStartDocument(const QString& docType, const QString& systemId);
+	bool writeEndDocument();
+
+	void writeStartElement(const QString& name);
+	void writeEndElement();
+
+	// an attribute "format" with the value "hex" gives the hexadecimal dump of a binary element
+	void writeTextElement(const QString& name, const QString& text);
+	void writeTextElement(const QString& name, const QString& text, const QString& attribute, const QString& value);
+
+	// comments are dropped
+	void writeComment(const QString& text);
+
+	static const int BUFFER_SIZE = 64 * 1024;
+
+	// EBML encoding, also used by the Matroska muxer
+	static void appendId(QByteArray& out, uint32_t id);
+	// shortest variable size integer unless a length is given
+	static void appendSize(QByteArray& out, uint64_t size, int length = 0);
+
+private:
+	enum Type {TYPE_MASTER, TYPE_UINT, TYPE_UTF8, TYPE_BINARY, TYPE_TIME};
+
+	struct Element
+	{
+		const char *name;
+		uint32_t id;
+		Type type;
+	};
+
+	static const Element ELEMENTS[];
+	static const Element* FindElement(const QString& name);
+
+	void writeData(uint32_t id, const QByteArray& data);
+	void patchSize(qint64 position, uint64_t size);
+	qint64 position() const;
+	bool flush();
+
+	QIODevice *device_;
+	QByteArray buffer_;
+	qint64 flushed_;
+	// position of the size field of the open master elements, -1 for an unknown element
+	std::vector<qint64> masters_;
+	bool failed_;
+};
+
+#endif // EBML_WRITER_H
@@ -0,0 +1,125 @@
+#include "extractionmanifest.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextStream>
+
+QString ExtractionManifest::FILENAME ("dmx_manifest.txt");
+
+static const QString MANIFEST_HEADER ("# DMX manifest v1");
+
+ExtractionManifest::ExtractionManifest()
+{
+}
+
+bool ExtractionManifest::load(const QString& destinationPath)
+{
+	destinationPath_ = destinationPath;
+	passes_.clear();
+
+	QFile file(destinationPath_ + QDir::separator() + FILENAME);
+
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		return false;
+
+	QTextStream in(&file);
+
+	if (in.readLine() != MANIFEST_HEADER)
+		return false;
+
+	PassEntry *pass = 0;
+
+	while (!in.atEnd())
+	{
+		const QString line = in.readLine();
+		const QStringList fields = line.split(' ', QString::SkipEmptyParts);
+
+		if (fields.size() == 3 && fields.at(0) == "pass")
+		{
+			pass = &passes_[fields.at(1)];
+			pass->fingerprint = QByteArray::fromHex(fields.at(2).toLatin1());
+			pass->files.clear();
+		}
+		else if (fields.size() >= 3 && fields.at(0) == "file" && pass != 0)
+		{
+			// the file name is the rest of the line
+			pass->files.append(FileEntry(line.section(' ', 2), fields.at(1).toLongLong()));
+		}
+	}
+
+	return true;
+}
+
+bool ExtractionManifest::save() const
+{
+	QSaveFile file(destinationPath_ + QDir::separator() + FILENAME);
+
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+	{
+		fprintf(stderr, "Could not write the extraction manifest\n");
+		return false;
+	}
+
+	QTextStream out(&file);
+	out << MANIFEST_HEADER << '\n';
+
+	QStringList names = passes_.keys();
+	names.sort();
+
+	for (int index = 0; index < names.size(); ++index)
+	{
+		const PassEntry& pass = passes_[names.at(index)];
+
+		out << "pass " << names.at(index) << ' ' << pass.fingerprint.toHex() << '\n';
+
+		for (int fileIndex = 0; fileIndex < pass.files.size(); ++fileIndex)
+			out << "file " << pass.files.at(fileIndex).second << ' ' << pass.files.at(fileIndex).first << '\n';
+	}
+
+	out.flush();
+	return file.commit();
+}
+
+bool ExtractionManifest::isUpToDate(const QString& name, const QByteArray& fingerprint) const
+{
+	if (!passes_.contains(name))
+		return false;
+
+	const PassEntry& pass = passes_[name];
+
+	if (pass.fingerprint != fingerprint || pass.files.isEmpty())
+		return false;
+
+	for (int index = 0; index < pass.files.size(); ++index)
+	{
+		QFileInfo info(destinationPath_ + QDir::separator() + pass.files.at(index).first);
+
+		if (!info.exists() || info.size() != pass.files.at(index).second)
+			return false;
+	}
+
+	return true;
+}
+
+void ExtractionManifest::update(const QString& name, const QByteArray& fingerprint, const QStringList& files)
+{
+	PassEntry pass;
+	pass.fingerprint = fingerprint;
+
+	for (int index = 0; index < files.size(); ++index)
+	{
+		QFileInfo info(files.at(index));
+
+		if (info.exists())
+			pass.files.append(FileEntry(info.fileName(), info.size()));
+	}
+
+	passes_.insert(name, pass);
+}
+
+void ExtractionManifest::remove(const QString& name)
+{
+	passes_.remove(name);
+}
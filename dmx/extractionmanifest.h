@@ -0,0 +1,41 @@
+#ifndef EXTRACTION_MANIFEST_H
+#define EXTRACTION_MANIFEST_H
+
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+
+// Remembers, for each demuxing pass (VMG, VTSM01, VTS01...), the fingerprint
+// of its input and the files it produced, so a rerun can skip the passes
+// whose outputs are still up to date
+class ExtractionManifest
+{
+public:
+	ExtractionManifest();
+
+	bool load(const QString& destinationPath);
+	bool save() const;
+
+	// true if the pass was produced from the same fingerprint and its files are untouched
+	bool isUpToDate(const QString& name, const QByteArray& fingerprint) const;
+
+	void update(const QString& name, const QByteArray& fingerprint, const QStringList& files);
+	void remove(const QString& name);
+
+	static QString FILENAME;
+
+private:
+	typedef QPair<QString, qint64> FileEntry;
+
+	struct PassEntry
+	{
+		QByteArray fingerprint;
+		QList<FileEntry> files;
+	};
+
+	QString destinationPath_;
+	QHash<QString, PassEntry> passes_;
+};
+
+#endif // EXTRACTION_MANIFEST_H
@@ -287,6 +287,18 @@ static int file_close(dvd_input_t dev)
 }
 
 
+/**
+ * return the file descriptor of a plain file input.
+ */
+int dvdinput_fd(dvd_input_t dev)
+{
+  if(dev == NULL || dvdinput_open != file_open)
+    return -1;
+
+  return dev->fd;
+}
+
+
 /**
  * Setup read functions with either libdvdcss or minimal DVD access.
  */
@@ -63,6 +63,11 @@ extern int         (*dvdinput_title) (dvd_input_t, int);
 extern int         (*dvdinput_read)  (dvd_input_t, void *, int, int);
 extern char *      (*dvdinput_error) (dvd_input_t);
 
+/**
+ * File descriptor of an input opened without libdvdcss, -1 otherwise.
+ */
+int dvdinput_fd(dvd_input_t);
+
 /**
  * Setup function accessed by dvd_reader.c.  Returns 1 if there is CSS support.
  */
@@ -97,10 +97,29 @@ struct dvd_reader_s {
   /* Filesystem cache */
   int udfcache_level; /* 0 - turned off, 1 - on */
   void *udfcache;
+
+  /* Files located on the disc, see DVDAddFileEntry */
+  struct dvd_file_entry_s *file_entries;
+  int file_entry_count;
+  int file_entry_max;
+};
+
+struct dvd_file_entry_s {
+  char *name;
+  uint32_t start;       /* first logical block, 0 for a directory tree */
+  uint32_t size;        /* in bytes */
+  unsigned char *data;  /* whole content of an IFO or BUP file, or NULL */
 };
 
+static uint32_t FindFileUDF( dvd_reader_t *dvd, char *filename,
+                             uint32_t *size );
+
 #define TITLES_MAX 9
 
+/* IFO and BUP files up to this size are read at once and parsed from
+ * memory. They are usually a few hundred KB at most. */
+#define IFO_CACHE_MAX_BLOCKS 4096
+
 struct dvd_file_s {
   /* Basic information. */
   dvd_reader_t *dvd;
@@ -122,8 +141,14 @@ struct dvd_file_s {
   /* Cache of the dvd_file. If not NULL, the cache corresponds to the whole
    * dvd_file. Used only for IFO and BUP. */
   unsigned char *cache;
+  /* Size of the cache in bytes, filesize may grow with DVDFileSeekForce. */
+  size_t cache_size;
 };
 
+static int DVDReadBlocksPath( const dvd_file_t *dvd_file, unsigned int offset,
+                              size_t block_count, unsigned char *data,
+                              int encrypted );
+
 int InternalUDFReadBlocksRaw( const dvd_reader_t *device, uint32_t lb_number,
                       size_t block_count, unsigned char *data,
                       int encrypted );
@@ -190,7 +215,7 @@ static int initAllCSSKeys( dvd_reader_t *dvd )
     } else {
       sprintf( filename, "/VIDEO_TS/VTS_%02d_%d.VOB", title, 0 );
     }
-    start = UDFFindFile( dvd, filename, &len );
+    start = FindFileUDF( dvd, filename, &len );
     if( start != 0 && len != 0 ) {
       /* Perform CSS key cracking for this title. */
       fprintf( stderr, "libdvdread: Get key for %s at 0x%08x\n",
@@ -207,7 +232,7 @@ static int initAllCSSKeys( dvd_reader_t *dvd )
 
     gettimeofday( &t_s, NULL );
     sprintf( filename, "/VIDEO_TS/VTS_%02d_%d.VOB", title, 1 );
-    start = UDFFindFile( dvd, filename, &len );
+    start = FindFileUDF( dvd, filename, &len );
     if( start == 0 || len == 0 ) break;
 
     /* Perform CSS key cracking for this title. */
@@ -262,6 +287,10 @@ static dvd_reader_t *DVDOpenImageFile( const char *location,
   dvd->udfcache_level = DEFAULT_UDF_CACHE_LEVEL;
   dvd->udfcache = NULL;
 
+  dvd->file_entries = NULL;
+  dvd->file_entry_count = 0;
+  dvd->file_entry_max = 0;
+
   if( have_css ) {
     /* Only if DVDCSS_METHOD = title, a bit if it's disc or if
      * DVDCSS_METHOD = key but region mismatch. Unfortunately we
@@ -290,6 +319,10 @@ static dvd_reader_t *DVDOpenPath( const char *path_root )
   dvd->udfcache_level = DEFAULT_UDF_CACHE_LEVEL;
   dvd->udfcache = NULL;
 
+  dvd->file_entries = NULL;
+  dvd->file_entry_count = 0;
+  dvd->file_entry_max = 0;
+
   dvd->css_state = 0; /* Only used in the UDF path */
   dvd->css_title = 0; /* Only matters in the UDF path */
 
@@ -644,10 +677,154 @@ void DVDClose( dvd_reader_t *dvd )
     if( dvd->dev ) dvdinput_close( dvd->dev );
     if( dvd->path_root ) free( dvd->path_root );
     if( dvd->udfcache ) FreeUDFCache( dvd->udfcache );
+    if( dvd->file_entries ) {
+      int i;
+
+      for( i = 0; i < dvd->file_entry_count; ++i ) {
+        free( dvd->file_entries[ i ].name );
+        free( dvd->file_entries[ i ].data );
+      }
+      free( dvd->file_entries );
+    }
     free( dvd );
   }
 }
 
+static struct dvd_file_entry_s *FindFileEntry( dvd_reader_t *dvd,
+                                               const char *name )
+{
+  int i;
+
+  for( i = 0; i < dvd->file_entry_count; ++i ) {
+    if( !strcmp( dvd->file_entries[ i ].name, name ) )
+      return &dvd->file_entries[ i ];
+  }
+  return NULL;
+}
+
+int DVDFileEntryCount( dvd_reader_t *dvd )
+{
+  return dvd ? dvd->file_entry_count : 0;
+}
+
+int DVDGetFileEntry( dvd_reader_t *dvd, int index, const char **name,
+                     uint32_t *start, uint32_t *size,
+                     const unsigned char **data )
+{
+  if( !dvd || index < 0 || index >= dvd->file_entry_count )
+    return -1;
+
+  *name = dvd->file_entries[ index ].name;
+  *start = dvd->file_entries[ index ].start;
+  *size = dvd->file_entries[ index ].size;
+  *data = dvd->file_entries[ index ].data;
+  return 0;
+}
+
+int DVDAddFileEntry( dvd_reader_t *dvd, const char *name, uint32_t start,
+                     uint32_t size, const unsigned char *data )
+{
+  struct dvd_file_entry_s *entry;
+
+  if( !dvd || !name )
+    return -1;
+
+  entry = FindFileEntry( dvd, name );
+  if( entry ) {
+    /* Only the location and the content can be completed */
+    if( !entry->start && entry->size == size )
+      entry->start = start;
+    if( !entry->data && data && entry->size == size ) {
+      entry->data = malloc( size );
+      if( !entry->data )
+        return -1;
+      memcpy( entry->data, data, size );
+    }
+    return 0;
+  }
+
+  if( dvd->file_entry_count == dvd->file_entry_max ) {
+    int max = dvd->file_entry_max ? dvd->file_entry_max * 2 : 32;
+    struct dvd_file_entry_s *entries;
+
+    entries = realloc( dvd->file_entries, max * sizeof( *entries ) );
+    if( !entries )
+      return -1;
+    dvd->file_entries = entries;
+    dvd->file_entry_max = max;
+  }
+
+  entry = &dvd->file_entries[ dvd->file_entry_count ];
+  entry->name = strdup( name );
+  if( !entry->name )
+    return -1;
+  entry->start = start;
+  entry->size = size;
+  entry->data = NULL;
+  if( data ) {
+    entry->data = malloc( size );
+    if( !entry->data ) {
+      free( entry->name );
+      return -1;
+    }
+    memcpy( entry->data, data, size );
+  }
+
+  dvd->file_entry_count++;
+  return 0;
+}
+
+/**
+ * UDFFindFile() through the file entries, a file is searched only once.
+ */
+static uint32_t FindFileUDF( dvd_reader_t *dvd, char *filename,
+                             uint32_t *size )
+{
+  struct dvd_file_entry_s *entry;
+  uint32_t start;
+
+  entry = FindFileEntry( dvd, filename );
+  if( entry && entry->start ) {
+    *size = entry->size;
+    return entry->start;
+  }
+
+  start = UDFFindFile( dvd, filename, size );
+  if( start )
+    DVDAddFileEntry( dvd, filename, start, *size, NULL );
+  return start;
+}
+
+/**
+ * Fills the whole file cache of an IFO or BUP from its file entry
+ * (from_disc = 0), or records the content read from the disc in the file
+ * entries (from_disc = 1). Returns 1 if the cache was filled or recorded.
+ */
+static int LoadFileCache( dvd_file_t *dvd_file, const char *filename,
+                          uint32_t start, int from_disc )
+{
+  struct dvd_file_entry_s *entry;
+  size_t size = dvd_file->filesize * DVD_VIDEO_LB_LEN;
+
+  if( from_disc ) {
+    if( !dvd_file->cache )
+      return 0;
+    return DVDAddFileEntry( dvd_file->dvd, filename, start, (uint32_t) size,
+                            dvd_file->cache ) == 0;
+  }
+
+  entry = FindFileEntry( dvd_file->dvd, filename );
+  if( !entry || !entry->data || entry->size != size )
+    return 0;
+
+  dvd_file->cache = malloc( size );
+  if( !dvd_file->cache )
+    return 0;
+  memcpy( dvd_file->cache, entry->data, size );
+  dvd_file->cache_size = size;
+  return 1;
+}
+
 /**
  * Open an unencrypted file on a DVD image file.
  */
@@ -657,7 +834,7 @@ static dvd_file_t *DVDOpenFileUDF( dvd_reader_t *dvd, char *filename,
   uint32_t start, len;
   dvd_file_t *dvd_file;
 
-  start = UDFFindFile( dvd, filename, &len );
+  start = FindFileUDF( dvd, filename, &len );
   if( !start ) {
     fprintf( stderr, "libdvdread:DVDOpenFileUDF:UDFFindFile %s failed\n", filename );
     return NULL;
@@ -675,22 +852,29 @@ static dvd_file_t *DVDOpenFileUDF( dvd_reader_t *dvd, char *filename,
   memset( dvd_file->title_devs, 0, sizeof( dvd_file->title_devs ) );
   dvd_file->filesize = len / DVD_VIDEO_LB_LEN;
   dvd_file->cache = NULL;
+  dvd_file->cache_size = 0;
 
   /* Read the whole file in cache (unencrypted) if asked and if it doesn't
-   * exceed 128KB */
-  if( do_cache && len < 64 * DVD_VIDEO_LB_LEN ) {
+   * exceed IFO_CACHE_MAX_BLOCKS */
+  if( do_cache && dvd_file->filesize > 0
+      && dvd_file->filesize <= IFO_CACHE_MAX_BLOCKS
+      && !LoadFileCache( dvd_file, filename, start, 0 ) ) {
     int ret;
+    unsigned char *cache;
 
-    dvd_file->cache = malloc( len );
-    if( !dvd_file->cache )
+    cache = malloc( dvd_file->filesize * DVD_VIDEO_LB_LEN );
+    if( !cache )
         return dvd_file;
 
     ret = InternalUDFReadBlocksRaw( dvd, dvd_file->lb_start,
-                                    dvd_file->filesize, dvd_file->cache,
+                                    dvd_file->filesize, cache,
                                     DVDINPUT_NOFLAGS );
     if( ret != dvd_file->filesize ) {
-        free( dvd_file->cache );
-        dvd_file->cache = NULL;
+        free( cache );
+    } else {
+        dvd_file->cache = cache;
+        dvd_file->cache_size = dvd_file->filesize * DVD_VIDEO_LB_LEN;
+        LoadFileCache( dvd_file, filename, start, 1 );
     }
   }
 
@@ -759,7 +943,8 @@ static int findDVDFile( dvd_reader_t *dvd, const char *file, char *filename )
 /**
  * Open an unencrypted file from a DVD directory tree.
  */
-static dvd_file_t *DVDOpenFilePath( dvd_reader_t *dvd, char *filename )
+static dvd_file_t *DVDOpenFilePath( dvd_reader_t *dvd, char *filename,
+                                    int do_cache )
 {
   char full_path[ PATH_MAX + 1 ];
   dvd_file_t *dvd_file;
@@ -791,6 +976,7 @@ static dvd_file_t *DVDOpenFilePath( dvd_reader_t *dvd, char *filename )
   memset( dvd_file->title_devs, 0, sizeof( dvd_file->title_devs ) );
   dvd_file->filesize = 0;
   dvd_file->cache = NULL;
+  dvd_file->cache_size = 0;
 
   if( stat( full_path, &fileinfo ) < 0 ) {
     fprintf( stderr, "libdvdread: Can't stat() %s.\n", filename );
@@ -802,6 +988,28 @@ static dvd_file_t *DVDOpenFilePath( dvd_reader_t *dvd, char *filename )
   dvd_file->title_devs[ 0 ] = dev;
   dvd_file->filesize = dvd_file->title_sizes[ 0 ];
 
+  /* Read the whole file in cache if asked, as for a DVD image file */
+  if( do_cache && dvd_file->filesize > 0
+      && dvd_file->filesize <= IFO_CACHE_MAX_BLOCKS
+      && !LoadFileCache( dvd_file, filename, 0, 0 ) ) {
+    int ret;
+    unsigned char *cache;
+
+    cache = malloc( dvd_file->filesize * DVD_VIDEO_LB_LEN );
+    if( !cache )
+        return dvd_file;
+
+    ret = DVDReadBlocksPath( dvd_file, 0, dvd_file->filesize, cache,
+                             DVDINPUT_NOFLAGS );
+    if( ret != dvd_file->filesize ) {
+        free( cache );
+    } else {
+        dvd_file->cache = cache;
+        dvd_file->cache_size = dvd_file->filesize * DVD_VIDEO_LB_LEN;
+        LoadFileCache( dvd_file, filename, 0, 1 );
+    }
+  }
+
   return dvd_file;
 }
 
@@ -816,7 +1024,7 @@ static dvd_file_t *DVDOpenVOBUDF( dvd_reader_t *dvd, int title, int menu )
   } else {
     sprintf( filename, "/VIDEO_TS/VTS_%02d_%d.VOB", title, menu ? 0 : 1 );
   }
-  start = UDFFindFile( dvd, filename, &len );
+  start = FindFileUDF( dvd, filename, &len );
   if( start == 0 ) return NULL;
 
   dvd_file = malloc( sizeof( dvd_file_t ) );
@@ -829,6 +1037,7 @@ static dvd_file_t *DVDOpenVOBUDF( dvd_reader_t *dvd, int title, int menu )
   memset( dvd_file->title_devs, 0, sizeof( dvd_file->title_devs ) );
   dvd_file->filesize = len / DVD_VIDEO_LB_LEN;
   dvd_file->cache = NULL;
+  dvd_file->cache_size = 0;
 
   /* Calculate the complete file size for every file in the VOBS */
   if( !menu ) {
@@ -836,7 +1045,7 @@ static dvd_file_t *DVDOpenVOBUDF( dvd_reader_t *dvd, int title, int menu )
 
     for( cur = 2; cur < 10; cur++ ) {
       sprintf( filename, "/VIDEO_TS/VTS_%02d_%d.VOB", title, cur );
-      if( !UDFFindFile( dvd, filename, &len ) ) break;
+      if( !FindFileUDF( dvd, filename, &len ) ) break;
       dvd_file->filesize += len / DVD_VIDEO_LB_LEN;
     }
   }
@@ -872,6 +1081,7 @@ static dvd_file_t *DVDOpenVOBPath( dvd_reader_t *dvd, int title, int menu )
   memset( dvd_file->title_devs, 0, sizeof( dvd_file->title_devs ) );
   dvd_file->filesize = 0;
   dvd_file->cache = NULL;
+  dvd_file->cache_size = 0;
 
   if( menu ) {
     dvd_input_t dev;
@@ -982,7 +1192,7 @@ dvd_file_t *DVDOpenFile( dvd_reader_t *dvd, int titlenum,
   if( dvd->isImageFile ) {
     return DVDOpenFileUDF( dvd, filename, do_cache );
   } else {
-    return DVDOpenFilePath( dvd, filename );
+    return DVDOpenFilePath( dvd, filename, do_cache );
   }
 }
 
@@ -1020,7 +1230,7 @@ static int DVDFileStatVOBUDF( dvd_reader_t *dvd, int title,
   else
     sprintf( filename, "/VIDEO_TS/VTS_%02d_%d.VOB", title, menu ? 0 : 1 );
 
-  if( !UDFFindFile( dvd, filename, &size ) )
+  if( !FindFileUDF( dvd, filename, &size ) )
     return -1;
 
   tot_size = size;
@@ -1032,7 +1242,7 @@ static int DVDFileStatVOBUDF( dvd_reader_t *dvd, int title,
 
     for( cur = 2; cur < 10; cur++ ) {
       sprintf( filename, "/VIDEO_TS/VTS_%02d_%d.VOB", title, cur );
-      if( !UDFFindFile( dvd, filename, &size ) )
+      if( !FindFileUDF( dvd, filename, &size ) )
         break;
 
       parts_size[ nr_parts ] = size;
@@ -1157,7 +1367,7 @@ int DVDFileStat( dvd_reader_t *dvd, int titlenum,
   }
 
   if( dvd->isImageFile ) {
-    if( UDFFindFile( dvd, filename, &size ) ) {
+    if( FindFileUDF( dvd, filename, &size ) ) {
       statbuf->size = size;
       statbuf->nr_parts = 1;
       statbuf->parts_size[ 0 ] = size;
@@ -1215,11 +1425,9 @@ static int DVDReadBlocksUDF( const dvd_file_t *dvd_file, uint32_t offset,
 {
   /* If the cache is present and we don't need to decrypt, use the cache to
    * feed the data */
-  if( dvd_file->cache && (encrypted & DVDINPUT_READ_DECRYPT) == 0 ) {
-    /* Check if we don't exceed the cache (or file) size */
-    if( block_count + offset > (size_t) dvd_file->filesize )
-      return 0;
-
+  if( dvd_file->cache && (encrypted & DVDINPUT_READ_DECRYPT) == 0
+      && (size_t)offset <= dvd_file->cache_size / DVD_VIDEO_LB_LEN
+      && block_count <= dvd_file->cache_size / DVD_VIDEO_LB_LEN - (size_t)offset ) {
     /* Copy the cache at a specified offset into data. offset and block_count
      * must be converted into bytes */
     memcpy( data, dvd_file->cache + (off_t)offset * (off_t)DVD_VIDEO_LB_LEN,
@@ -1247,6 +1455,16 @@ static int DVDReadBlocksPath( const dvd_file_t *dvd_file, unsigned int offset,
   int i;
   int ret, ret2, off;
 
+  /* If the cache is present and we don't need to decrypt, use the cache to
+   * feed the data */
+  if( dvd_file->cache && (encrypted & DVDINPUT_READ_DECRYPT) == 0
+      && (size_t)offset <= dvd_file->cache_size / DVD_VIDEO_LB_LEN
+      && block_count <= dvd_file->cache_size / DVD_VIDEO_LB_LEN - (size_t)offset ) {
+    memcpy( data, dvd_file->cache + (off_t)offset * (off_t)DVD_VIDEO_LB_LEN,
+            (off_t)block_count * (off_t)DVD_VIDEO_LB_LEN );
+    return block_count;
+  }
+
   ret = 0;
   ret2 = 0;
   for( i = 0; i < TITLES_MAX; ++i ) {
@@ -1341,6 +1559,45 @@ ssize_t DVDReadBlocks( dvd_file_t *dvd_file, int offset,
   return (ssize_t)ret;
 }
 
+int DVDFileBlockSource( dvd_file_t *dvd_file, int offset,
+                        int *fd, int64_t *position )
+{
+  int i;
+  uint32_t block;
+
+  /* Check arguments. */
+  if( dvd_file == NULL || offset < 0 || fd == NULL || position == NULL )
+    return 0;
+
+  if( offset >= dvd_file->filesize )
+    return 0;
+
+  if( dvd_file->dvd->isImageFile ) {
+    *fd = dvdinput_fd( dvd_file->dvd->dev );
+    if( *fd < 0 ) return 0;
+
+    *position = ( (int64_t)dvd_file->lb_start + offset ) * DVD_VIDEO_LB_LEN;
+    return dvd_file->filesize - offset;
+  }
+
+  /* The blocks are split across the VOB files, see DVDReadBlocksPath */
+  block = (uint32_t)offset;
+  for( i = 0; i < TITLES_MAX; ++i ) {
+    if( !dvd_file->title_sizes[ i ] ) return 0;
+
+    if( block < dvd_file->title_sizes[ i ] ) {
+      *fd = dvdinput_fd( dvd_file->title_devs[ i ] );
+      if( *fd < 0 ) return 0;
+
+      *position = (int64_t)block * DVD_VIDEO_LB_LEN;
+      return dvd_file->title_sizes[ i ] - block;
+    }
+    block -= dvd_file->title_sizes[ i ];
+  }
+
+  return 0;
+}
+
 int32_t DVDFileSeek( dvd_file_t *dvd_file, int32_t offset )
 {
   /* Check arguments. */
@@ -1386,6 +1643,15 @@ ssize_t DVDReadBytes( dvd_file_t *dvd_file, void *data, size_t byte_size )
   if( dvd_file == NULL || data == NULL )
     return -1;
 
+  /* IFO parsing does many small reads, serve them straight from the cache */
+  if( dvd_file->cache
+      && (off_t)dvd_file->seek_pos + (off_t)byte_size
+         <= (off_t)dvd_file->cache_size ) {
+    memcpy( data, dvd_file->cache + dvd_file->seek_pos, byte_size );
+    DVDFileSeekForce(dvd_file, dvd_file->seek_pos + byte_size, -1);
+    return byte_size;
+  }
+
   seek_sector = dvd_file->seek_pos / DVD_VIDEO_LB_LEN;
   seek_byte   = dvd_file->seek_pos % DVD_VIDEO_LB_LEN;
 
@@ -33,6 +33,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <ctype.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -119,6 +120,13 @@ struct icbmap {
   uint8_t filetype;
 };
 
+/* A file of the VIDEO_TS directory */
+struct udf_file {
+  char *name;
+  uint32_t lb;    /* first logical block, 0 for an empty file */
+  uint32_t size;  /* in bytes */
+};
+
 struct udf_cache {
   int avdp_valid;
   struct avdp_t avdp;
@@ -132,6 +140,13 @@ struct udf_cache {
   struct lbudf *lbs;
   int map_num;
   struct icbmap *maps;
+  /* VIDEO_TS directory, enumerated once and hashed by upper case name.
+   * videots_valid is 1 once indexed, -1 if it could not be indexed. */
+  int videots_valid;
+  int file_num;
+  struct udf_file *files;
+  int bucket_num;
+  int *buckets; /* index in files + 1, 0 for an empty bucket */
 };
 
 typedef enum {
@@ -152,6 +167,13 @@ void FreeUDFCache(void *cache)
   }
   if(c->maps)
     free(c->maps);
+  if(c->files) {
+    int n;
+    for(n = 0; n < c->file_num; n++)
+      free(c->files[n].name);
+    free(c->files);
+  }
+  free(c->buckets);
   free(c);
 }
 
@@ -794,31 +816,28 @@ static int UDFFindPartition( dvd_reader_t *device, int partnum,
   return part->valid;
 }
 
-uint32_t UDFFindFile( dvd_reader_t *device, char *filename,
-                      uint32_t *filesize )
+/**
+ * Finds the partition and the root directory of the disc.
+ * return 1 on success, 0 on error;
+ */
+static int UDFGetRootDir( dvd_reader_t *device, struct Partition *partition,
+                          struct AD *RootDir )
 {
   uint8_t LogBlock_base[ DVD_VIDEO_LB_LEN + 2048 ];
   uint8_t *LogBlock = (uint8_t *)(((uintptr_t)LogBlock_base & ~((uintptr_t)2047)) + 2048);
   uint32_t lbnum;
   uint16_t TagID;
-  struct Partition partition;
-  struct AD RootICB, File, ICB;
-  char tokenline[ MAX_UDF_FILE_NAME_LEN ];
+  struct AD RootICB;
   uint8_t filetype;
 
-  *filesize = 0;
-  tokenline[0] = '\0';
-  strncat(tokenline, filename, MAX_UDF_FILE_NAME_LEN - 1);
-  memset(&ICB, 0, sizeof(ICB));
-
-  if(!(GetUDFCache(device, PartitionCache, 0, &partition) &&
+  if(!(GetUDFCache(device, PartitionCache, 0, partition) &&
        GetUDFCache(device, RootICBCache, 0, &RootICB))) {
     /* Find partition, 0 is the standard location for DVD Video.*/
-    if( !UDFFindPartition( device, 0, &partition ) ) return 0;
-    SetUDFCache(device, PartitionCache, 0, &partition);
+    if( !UDFFindPartition( device, 0, partition ) ) return 0;
+    SetUDFCache(device, PartitionCache, 0, partition);
 
     /* Find root dir ICB */
-    lbnum = partition.Start;
+    lbnum = partition->Start;
     do {
       if( DVDReadLBUDF( device, lbnum++, 1, LogBlock, 0 ) <= 0 )
         TagID = 0;
@@ -828,7 +847,7 @@ uint32_t UDFFindFile( dvd_reader_t *device, char *filename,
       /* File Set Descriptor */
       if( TagID == FileSetDescriptor )  /* File Set Descriptor */
         UDFLongAD( &LogBlock[ 400 ], &RootICB );
-    } while( ( lbnum < partition.Start + partition.Length )
+    } while( ( lbnum < partition->Start + partition->Length )
              && ( TagID != TerminatingDescriptor ) && ( TagID != FileSetDescriptor) );
 
     /* Sanity checks. */
@@ -840,10 +859,189 @@ uint32_t UDFFindFile( dvd_reader_t *device, char *filename,
   }
 
   /* Find root dir */
-  if( !UDFMapICB( device, RootICB, &filetype, &partition, &File ) )
+  if( !UDFMapICB( device, RootICB, &filetype, partition, RootDir ) )
     return 0;
   if( filetype != 4 )
     return 0;  /* Root dir should be dir */
+  return 1;
+}
+
+static unsigned int UDFHashName( const char *name )
+{
+  /* FNV-1a, case insensitive like the directory scan */
+  unsigned int hash = 2166136261u;
+
+  while( *name ) {
+    hash ^= (unsigned char) toupper( (unsigned char) *name++ );
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * Enumerates the VIDEO_TS directory once and hashes its files, so that
+ * looking for a file afterwards needs no directory scan and no read.
+ * return 1 on success, 0 on error;
+ */
+static int UDFIndexVideoTS( dvd_reader_t *device, struct udf_cache *c )
+{
+  char filename[ MAX_UDF_FILE_NAME_LEN ];
+  struct Partition partition;
+  struct AD RootDir, ICB, Dir, File;
+  uint8_t *dir_base, *dir;
+  uint32_t dir_lba;
+  uint16_t TagID;
+  uint8_t filechar, filetype;
+  unsigned int p;
+  int n;
+
+  if( !UDFGetRootDir( device, &partition, &RootDir ) )
+    return 0;
+  if( !UDFScanDir( device, RootDir, "VIDEO_TS", &partition, &ICB, 0 ) )
+    return 0;
+  if( !UDFMapICB( device, ICB, &filetype, &partition, &Dir ) || filetype != 4 )
+    return 0;
+
+  dir_lba = ( Dir.Length + DVD_VIDEO_LB_LEN - 1 ) / DVD_VIDEO_LB_LEN;
+  if( ( dir_base = malloc( dir_lba * DVD_VIDEO_LB_LEN + 2048 ) ) == NULL )
+    return 0;
+  dir = (uint8_t *)(((uintptr_t)dir_base & ~((uintptr_t)2047)) + 2048);
+  if( DVDReadLBUDF( device, partition.Start + Dir.Location, dir_lba, dir, 0 ) <= 0 ) {
+    free( dir_base );
+    return 0;
+  }
+
+  p = 0;
+  while( p < Dir.Length ) {
+    struct udf_file *files;
+
+    UDFDescriptor( &dir[ p ], &TagID );
+    if( TagID != FileIdentifierDescriptor )
+      break;
+    p += UDFFileIdentifier( &dir[ p ], &filechar, filename, &ICB );
+
+    /* skip the parent directory entry */
+    if( !filename[ 0 ] || ( filechar & 0x08 ) )
+      continue;
+    if( !UDFMapICB( device, ICB, &filetype, &partition, &File ) )
+      continue;
+    if( File.Partition != 0 )
+      continue;
+
+    files = realloc( c->files, ( c->file_num + 1 ) * sizeof( struct udf_file ) );
+    if( !files )
+      goto error;
+    c->files = files;
+    c->files[ c->file_num ].name = strdup( filename );
+    if( !c->files[ c->file_num ].name )
+      goto error;
+    /* Hack to not return partition.Start for empty files. */
+    c->files[ c->file_num ].lb = File.Location ? partition.Start + File.Location : 0;
+    c->files[ c->file_num ].size = File.Length;
+    c->file_num++;
+  }
+  free( dir_base );
+  dir_base = NULL;
+
+  /* open addressing, at most half full */
+  c->bucket_num = 64;
+  while( c->bucket_num < 2 * c->file_num )
+    c->bucket_num *= 2;
+  c->buckets = calloc( c->bucket_num, sizeof( int ) );
+  if( !c->buckets )
+    goto error;
+
+  for( n = 0; n < c->file_num; n++ ) {
+    unsigned int bucket = UDFHashName( c->files[ n ].name ) & ( c->bucket_num - 1 );
+
+    while( c->buckets[ bucket ] )
+      bucket = ( bucket + 1 ) & ( c->bucket_num - 1 );
+    c->buckets[ bucket ] = n + 1;
+  }
+
+  c->videots_valid = 1;
+  return 1;
+
+error:
+  /* a partial index would hide files, scan the directory instead */
+  free( dir_base );
+  for( n = 0; n < c->file_num; n++ )
+    free( c->files[ n ].name );
+  free( c->files );
+  c->files = NULL;
+  c->file_num = 0;
+  return 0;
+}
+
+/**
+ * Looks for a file of the VIDEO_TS directory in its index.
+ * return 1 if the index could be used, 0 otherwise.
+ */
+static int UDFFindVideoTSFile( dvd_reader_t *device, const char *filename,
+                               uint32_t *lb, uint32_t *filesize )
+{
+  struct udf_cache *c;
+  unsigned int bucket;
+
+  if( strncasecmp( filename, "/VIDEO_TS/", 10 ) || strchr( filename + 10, '/' ) )
+    return 0;
+  filename += 10;
+
+  if(DVDUDFCacheLevel(device, -1) <= 0)
+    return 0;
+
+  c = (struct udf_cache *)GetUDFCacheHandle(device);
+  if(c == NULL) {
+    c = calloc(1, sizeof(struct udf_cache));
+    if(c == NULL)
+      return 0;
+    SetUDFCacheHandle(device, c);
+  }
+
+  /* -1: the index could not be built, do not try again */
+  if( c->videots_valid < 0 )
+    return 0;
+  if( !c->videots_valid && !UDFIndexVideoTS( device, c ) ) {
+    c->videots_valid = -1;
+    return 0;
+  }
+
+  *lb = 0;
+  *filesize = 0;
+  bucket = UDFHashName( filename ) & ( c->bucket_num - 1 );
+  while( c->buckets[ bucket ] ) {
+    struct udf_file *file = &c->files[ c->buckets[ bucket ] - 1 ];
+
+    if( !strcasecmp( file->name, filename ) ) {
+      *lb = file->lb;
+      *filesize = file->size;
+      break;
+    }
+    bucket = ( bucket + 1 ) & ( c->bucket_num - 1 );
+  }
+  return 1;
+}
+
+uint32_t UDFFindFile( dvd_reader_t *device, char *filename,
+                      uint32_t *filesize )
+{
+  struct Partition partition;
+  struct AD File, ICB;
+  char tokenline[ MAX_UDF_FILE_NAME_LEN ];
+  uint8_t filetype;
+  uint32_t lb;
+
+  *filesize = 0;
+
+  if( UDFFindVideoTSFile( device, filename, &lb, filesize ) )
+    return lb;
+
+  tokenline[0] = '\0';
+  strncat(tokenline, filename, MAX_UDF_FILE_NAME_LEN - 1);
+  memset(&ICB, 0, sizeof(ICB));
+
+  if( !UDFGetRootDir( device, &partition, &File ) )
+    return 0;
   {
     int cache_file_info = 0;
     /* Tokenize filepath */
@@ -207,6 +207,23 @@ void DVDCloseFile( dvd_file_t * );
  */
 ssize_t DVDReadBlocks( dvd_file_t *, int, size_t, unsigned char * );
 
+/**
+ * Locates a block of a VOB file in the underlying image or VOB file, so it can
+ * be copied as it is without going through DVDReadBlocks.  This is only
+ * possible when the input is read without libdvdcss, otherwise the data on the
+ * source may differ from the decrypted blocks.
+ *
+ * @param dvd_file  A file read handle.
+ * @param offset Block offset from the start of the file.
+ * @param fd Receives a file descriptor of the source, owned by libdvdread.
+ * @param position Receives the byte position of the block in the source.
+ * @return Returns the number of blocks stored contiguously from that position,
+ *         0 if the block can't be located.
+ *
+ * blocks = DVDFileBlockSource(dvd_file, offset, &fd, &position);
+ */
+int DVDFileBlockSource( dvd_file_t *, int, int *, int64_t * );
+
 /**
  * Seek to the given position in the file.  Returns the resulting position in
  * bytes from the beginning of the file.  The seek position is only used for
@@ -321,6 +338,28 @@ int DVDISOVolumeInfo( dvd_reader_t *, char *, unsigned int,
  */
 int DVDUDFCacheLevel( dvd_reader_t *, int );
 
+/**
+ * Files located on the disc by the reader, so that the layout of a disc
+ * can be kept between runs. A file with an entry is not searched again on
+ * the disc and the content of an IFO or BUP file with an entry is not read
+ * again.
+ *
+ * @param dvd A read handle.
+ * @param index The entry to get, 0 to DVDFileEntryCount() - 1.
+ * @param name The file name, as in "/VIDEO_TS/VTS_01_0.IFO".
+ * @param start The first logical block of the file on a DVD image, 0 on
+ *              a directory tree.
+ * @param size The size of the file in bytes.
+ * @param data The whole content of an IFO or BUP file, NULL otherwise.
+ * @return 0 on success, -1 on error.
+ */
+int DVDFileEntryCount( dvd_reader_t * );
+int DVDGetFileEntry( dvd_reader_t *, int index, const char **name,
+                     uint32_t *start, uint32_t *size,
+                     const unsigned char **data );
+int DVDAddFileEntry( dvd_reader_t *, const char *name, uint32_t start,
+                     uint32_t size, const unsigned char *data );
+
 #ifdef __cplusplus
 };
 #endif
@@ -0,0 +1,109 @@
+#include "livemetrics.h"
+
+#include <QSaveFile>
+#include <QTextStream>
+
+LiveMetrics::LiveMetrics()
+	: title(-1), menu(0), vob(0), cell(0), sector(0), sectorCount(0), sectorsRead(0)
+	, videoBufferBytes(0), abortLatency(-1)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+MetricsPublisher::MetricsPublisher(const LiveMetrics& metrics, const QString& filename)
+	: metrics_(metrics), filename_(filename), stopRequested_(false), lastPublish_(0), lastSectorsRead_(0)
+{
+	for (int streamID = 0; streamID < 256; ++streamID)
+		lastStreamBytes_[streamID] = 0;
+}
+
+MetricsPublisher::~MetricsPublisher()
+{
+	stop();
+}
+
+void MetricsPublisher::stop()
+{
+	stopRequested_ = true;
+	wait();
+}
+
+void MetricsPublisher::run()
+{
+	timer_.start();
+
+	while (!stopRequested_)
+	{
+		publish();
+
+		// stay responsive to stop()
+		for (unsigned long slept = 0; slept < INTERVAL && !stopRequested_; slept += 100)
+			msleep(100);
+	}
+
+	publish();
+}
+
+// Counters restart with each pass, a smaller value than the previous one means a new pass
+template <typename T>
+static T Delta(T current, T previous)
+{
+	return (current >= previous) ? current - previous : current;
+}
+
+void MetricsPublisher::publish()
+{
+	const qint64 now = timer_.elapsed();
+	const double seconds = (now > lastPublish_) ? (now - lastPublish_) / 1000.0 : 0.0;
+
+	QSaveFile file(filename_);
+
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+		return;
+
+	QTextStream out(&file);
+
+	out << "# TYPE dmx_title gauge\n" << "dmx_title " << metrics_.title.load() << '\n';
+	out << "# TYPE dmx_menu gauge\n" << "dmx_menu " << metrics_.menu.load() << '\n';
+	out << "# TYPE dmx_vob gauge\n" << "dmx_vob " << metrics_.vob.load() << '\n';
+	out << "# TYPE dmx_cell gauge\n" << "dmx_cell " << metrics_.cell.load() << '\n';
+	out << "# TYPE dmx_sector gauge\n" << "dmx_sector " << metrics_.sector.load() << '\n';
+	out << "# TYPE dmx_sectors gauge\n" << "dmx_sectors " << metrics_.sectorCount.load() << '\n';
+
+	const quint32 sectorsRead = metrics_.sectorsRead.load();
+	out << "# TYPE dmx_sectors_read counter\n" << "dmx_sectors_read " << sectorsRead << '\n';
+	out << "# TYPE dmx_sectors_per_second gauge\n" << "dmx_sectors_per_second "
+		<< (seconds > 0.0 ? Delta(sectorsRead, lastSectorsRead_) / seconds : 0.0) << '\n';
+	lastSectorsRead_ = sectorsRead;
+
+	out << "# TYPE dmx_writer_bytes counter\n";
+	for (int streamID = 0; streamID < 256; ++streamID)
+	{
+		const qint64 bytes = metrics_.streamBytes[streamID].load();
+		if (bytes != 0)
+			out << QString("dmx_writer_bytes{stream=\"0x%1\"} ").arg(streamID, 2, 16, QChar('0')) << bytes << '\n';
+	}
+
+	out << "# TYPE dmx_writer_mbytes_per_second gauge\n";
+	for (int streamID = 0; streamID < 256; ++streamID)
+	{
+		const qint64 bytes = metrics_.streamBytes[streamID].load();
+		if (bytes != 0)
+		{
+			out << QString("dmx_writer_mbytes_per_second{stream=\"0x%1\"} ").arg(streamID, 2, 16, QChar('0'))
+				<< (seconds > 0.0 ? Delta(bytes, lastStreamBytes_[streamID]) / (seconds * 1024.0 * 1024.0) : 0.0) << '\n';
+		}
+		lastStreamBytes_[streamID] = bytes;
+	}
+
+	out << "# TYPE dmx_video_buffer_bytes gauge\n" << "dmx_video_buffer_bytes " << metrics_.videoBufferBytes.load() << '\n';
+
+	if (metrics_.abortLatency.load() >= 0)
+		out << "# TYPE dmx_abort_latency_ms gauge\n" << "dmx_abort_latency_ms " << metrics_.abortLatency.load() << '\n';
+
+	out.flush();
+	file.commit();
+
+	lastPublish_ = now;
+}
@@ -0,0 +1,57 @@
+#ifndef LIVE_METRICS_H
+#define LIVE_METRICS_H
+
+#include <QString>
+#include <QThread>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+
+// Counters of a running extraction. They are written by the demux thread
+// and read by the MetricsPublisher without any lock.
+struct LiveMetrics
+{
+	LiveMetrics();
+
+	QAtomicInteger<int> title;
+	QAtomicInteger<int> menu;
+	QAtomicInteger<int> vob;
+	QAtomicInteger<int> cell;
+	QAtomicInteger<quint32> sector;
+	QAtomicInteger<quint32> sectorCount;
+	// counters of the current pass, they restart from 0 with each pass
+	QAtomicInteger<quint32> sectorsRead;
+	QAtomicInteger<qint64> streamBytes[256];
+	QAtomicInteger<int> videoBufferBytes;
+	// time between the abort request and the end of the demux loop in ms, -1 if not aborted
+	QAtomicInteger<int> abortLatency;
+};
+
+// Periodically rewrites a Prometheus text file with the values of LiveMetrics
+class MetricsPublisher : public QThread
+{
+public:
+	MetricsPublisher(const LiveMetrics& metrics, const QString& filename);
+	~MetricsPublisher();
+
+	// write the final values and stop the thread
+	void stop();
+
+	static const unsigned long INTERVAL = 1000;
+
+protected:
+	void run();
+
+private:
+	void publish();
+
+	const LiveMetrics& metrics_;
+	QString filename_;
+	volatile bool stopRequested_;
+
+	QElapsedTimer timer_;
+	qint64 lastPublish_;
+	quint32 lastSectorsRead_;
+	qint64 lastStreamBytes_[256];
+};
+
+#endif // LIVE_METRICS_H
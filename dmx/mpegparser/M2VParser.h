@@ -111,6 +111,11 @@ public:
     return mpgBuf->GetFreeBufferSpace();
   }
 
+  //Returns the amount of data waiting in the buffer
+  int32_t GetBufferLength(){
+    return mpgBuf->GetBufferLength();
+  }
+
   //Writes data to the internal buffer.
   int32_t WriteData(binary* data, uint32_t dataSize);
 
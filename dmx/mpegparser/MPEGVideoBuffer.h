@@ -143,6 +143,10 @@ public:
     return (myBuffer->buf_capacity - myBuffer->bytes_in_buf);
   }
 
+  int32_t GetBufferLength(){
+    return myBuffer->bytes_in_buf;
+  }
+
   void SetEndOfData(){
     chunkEnd = myBuffer->GetLength() - 1;
   }
@@ -0,0 +1,72 @@
+#include "muxjob.h"
+
+#include <stdio.h>
+#include <QFile>
+#include <QProcess>
+#include <QFileInfo>
+
+MuxJob::MuxJob(const QString& name, const QByteArray& fingerprint, const QStringList& files, const QString& outputFile)
+	: name_(name), fingerprint_(fingerprint), files_(files), outputFile_(outputFile), process_(0)
+{
+}
+
+MuxJob::~MuxJob()
+{
+	// QProcess kills a script still running
+	delete process_;
+}
+
+bool MuxJob::start()
+{
+	if (process_ || files_.isEmpty())
+		return false;
+
+	const QString script = files_.last();
+
+	process_ = new QProcess;
+	process_->setWorkingDirectory(QFileInfo(script).absolutePath());
+	// the progress of mkvmerge would be mixed with the one of the demuxer
+	process_->setStandardOutputFile(QProcess::nullDevice());
+
+#if (defined(WIN32) || defined(WIN64))
+	process_->start("cmd.exe", QStringList() << "/c" << script);
+#else
+	process_->start("/bin/sh", QStringList() << script);
+#endif
+
+	if (!process_->waitForStarted())
+	{
+		fprintf(stderr, "Could not run %s\n", qPrintable(script));
+		return false;
+	}
+
+	return true;
+}
+
+bool MuxJob::wait()
+{
+	if (!process_ || !process_->waitForFinished(-1))
+		return false;
+
+	// mkvmerge exits with 1 when it only had warnings
+	return process_->exitStatus() == QProcess::NormalExit && process_->exitCode() < 2 && QFile::exists(outputFile_);
+}
+
+void MuxJob::kill()
+{
+	if (!process_)
+		return;
+
+	process_->kill();
+	process_->waitForFinished(-1);
+	QFile::remove(outputFile_);
+}
+
+void MuxJob::removeIntermediateFiles() const
+{
+	for (int index = 0; index < files_.size(); ++index)
+	{
+		if (files_.at(index) != outputFile_)
+			QFile::remove(files_.at(index));
+	}
+}
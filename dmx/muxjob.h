@@ -0,0 +1,41 @@
+#ifndef MUX_JOB_H
+#define MUX_JOB_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+
+class QProcess;
+
+// Runs the mkvmerge script of a demuxed pass in the background, so the next
+// pass is demuxed while this one is muxed
+class MuxJob
+{
+public:
+	// the files of the pass, the script is the last one
+	MuxJob(const QString& name, const QByteArray& fingerprint, const QStringList& files, const QString& outputFile);
+	~MuxJob();
+
+	bool start();
+
+	// true when mkvmerge wrote the output file, with or without warnings
+	bool wait();
+	// stop mkvmerge, the output file is not usable
+	void kill();
+
+	const QString& name() const { return name_; }
+	const QByteArray& fingerprint() const { return fingerprint_; }
+	const QString& outputFile() const { return outputFile_; }
+
+	// delete the demuxed files and the script once the output file is written
+	void removeIntermediateFiles() const;
+
+private:
+	QString name_;
+	QByteArray fingerprint_;
+	QStringList files_;
+	QString outputFile_;
+	QProcess *process_;
+};
+
+#endif // MUX_JOB_H
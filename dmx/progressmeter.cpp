@@ -0,0 +1,55 @@
+#include "progressmeter.h"
+#include "utilities.h"
+
+#include "dvdread/dvd_reader.h"
+
+#include <algorithm>
+
+ProgressMeter::ProgressMeter(uint32_t sectorCount, uint32_t sectorsDone)
+	: sectorCount_(sectorCount ? sectorCount : 1), firstDone_(sectorsDone), done_(sectorsDone)
+	, nextCheck_(sectorsDone + CHECK_INTERVAL), percent_(-1), lastReport_(0)
+{
+	timer_.start();
+}
+
+bool ProgressMeter::update(uint32_t sectorsDone)
+{
+	done_ = std::min(sectorsDone, sectorCount_);
+	nextCheck_ = sectorsDone + CHECK_INTERVAL;
+
+	const qint64 now = timer_.elapsed();
+	const int currentPercent = int(uint64_t(done_) * 100 / sectorCount_);
+
+	if ((currentPercent != percent_ && now - lastReport_ >= MIN_INTERVAL) || now - lastReport_ >= MAX_INTERVAL)
+	{
+		percent_ = currentPercent;
+		lastReport_ = now;
+		return true;
+	}
+
+	return false;
+}
+
+int ProgressMeter::percent() const
+{
+	return int(uint64_t(done_) * 100 / sectorCount_);
+}
+
+QString ProgressMeter::details(unsigned vob, unsigned cell) const
+{
+	QString result = QString("VOB %1 Cell %2").arg(vob).arg(cell);
+
+	const qint64 elapsed = timer_.elapsed();
+	const uint32_t done = done_ - firstDone_;
+
+	if (elapsed > 0 && done > 0)
+	{
+		const double bytesPerSecond = double(done) * DVD_VIDEO_LB_LEN * 1000.0 / elapsed;
+		const uint64_t remaining = uint64_t(sectorCount_ - done_) * elapsed / done;
+
+		result += QString(" - %1 MB/s").arg(bytesPerSecond / (1024.0 * 1024.0), 0, 'f', 1);
+		result += QString(" - %1 left").arg(Utilities::FormatTime(remaining * 1000000).left(8));
+	}
+
+	return result;
+}
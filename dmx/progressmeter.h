@@ -0,0 +1,48 @@
+#ifndef PROGRESS_METER_H
+#define PROGRESS_METER_H
+
+#include <QString>
+#include <QElapsedTimer>
+#include <stdint.h>
+
+// Decides when the demuxing progress is worth reporting and computes the
+// transfer rate and the remaining time. The progress is a number of sectors
+// done out of the sectors to read, not a position in the file, as the read plan
+// and the resync skip sectors. The demux loop only compares the sectors done
+// with nextCheck(), the clock is read every CHECK_INTERVAL sectors.
+class ProgressMeter
+{
+public:
+	// the sectors done before the meter starts (on resume) do not count in the rate
+	ProgressMeter(uint32_t sectorCount, uint32_t sectorsDone = 0);
+
+	// Number of sectors done at which update() must be called again
+	inline uint32_t nextCheck() const
+	{
+		return nextCheck_;
+	}
+
+	// Returns true when a report is due, a change of percentage is reported
+	// at most every MIN_INTERVAL ms and the rate is refreshed every MAX_INTERVAL ms
+	bool update(uint32_t sectorsDone);
+
+	int percent() const;
+
+	// "VOB 1 Cell 2 - 10.5 MB/s - 00:12:34 left"
+	QString details(unsigned vob, unsigned cell) const;
+
+	static const uint32_t CHECK_INTERVAL = 256;
+	static const qint64 MIN_INTERVAL = 250;
+	static const qint64 MAX_INTERVAL = 1000;
+
+private:
+	uint32_t sectorCount_;
+	uint32_t firstDone_;
+	uint32_t done_;
+	uint32_t nextCheck_;
+	int percent_;
+	qint64 lastReport_;
+	QElapsedTimer timer_;
+};
+
+#endif // PROGRESS_METER_H
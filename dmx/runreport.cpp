@@ -0,0 +1,251 @@
+#include "runreport.h"
+#include "utilities.h"
+#include "vobparser/VobParser.h"
+
+#include <new>
+#include <stdlib.h>
+#include <QSaveFile>
+#include <QJsonObject>
+#include <QJsonDocument>
+
+#if (defined(WIN32) || defined(WIN64))
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+QString RunReport::FILENAME ("dmx_report.json");
+
+static const char *STAGE_NAMES[RunReport::STAGE_COUNT] = {"ifo_load", "vob_map", "demux", "writer_flush", "chapters", "mux_wait"};
+
+// ----------------------------------------------------------------------------
+// allocation counting, replaces the global operator new when enabled
+
+#ifdef CONFIG_ALLOC_STATS
+#include <QAtomicInteger>
+
+static QAtomicInteger<qint64> allocationCount;
+
+void* operator new(size_t size)
+{
+	allocationCount.fetchAndAddRelaxed(1);
+
+	void *result = malloc(size ? size : 1);
+	if (!result)
+		throw std::bad_alloc();
+	return result;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *pointer) throw()
+{
+	free(pointer);
+}
+
+void operator delete[](void *pointer) throw()
+{
+	free(pointer);
+}
+#endif
+
+// ----------------------------------------------------------------------------
+
+RunReport::StageTimer::StageTimer(RunReport& report, Stage stage)
+	: report_(report), stage_(stage), running_(true), cpuStart_(RunReport::CpuTime())
+{
+	timer_.start();
+}
+
+RunReport::StageTimer::~StageTimer()
+{
+	stop();
+}
+
+qint64 RunReport::StageTimer::stop()
+{
+	if (!running_)
+		return 0;
+
+	running_ = false;
+
+	const qint64 wall = timer_.nsecsElapsed();
+	report_.stageWall_[stage_] += wall;
+	report_.stageCpu_[stage_] += RunReport::CpuTime() - cpuStart_;
+
+	return wall;
+}
+
+// ----------------------------------------------------------------------------
+
+RunReport::RunReport()
+{
+	start(QString());
+}
+
+void RunReport::start(const QString& sourcePath)
+{
+	sourcePath_ = sourcePath;
+	passes_ = QJsonArray();
+
+	for (int stage = 0; stage < STAGE_COUNT; ++stage)
+	{
+		stageWall_[stage] = 0;
+		stageCpu_[stage] = 0;
+	}
+
+	cpuStart_ = CpuTime();
+	allocationStart_ = AllocationCount();
+	timer_.start();
+}
+
+void RunReport::addPass(const QString& name, const VobParser& parser, qint64 demuxTime)
+{
+	const CompositeDemuxWriter& demuxer = parser.GetDemuxer();
+
+	QJsonObject pass;
+	pass.insert("name", name);
+	pass.insert("sectors_read", double(parser.GetSectorsRead()));
+	pass.insert("read_ms", double(parser.GetReadTime() / 1000000));
+	pass.insert("parse_ms", double((demuxTime - qint64(parser.GetReadTime())) / 1000000));
+
+	QJsonArray streams;
+
+	for (int streamID = 0; streamID < 256; ++streamID)
+	{
+		if (demuxer.GetPacketCount(streamID) == 0)
+			continue;
+
+		QJsonObject stream;
+		stream.insert("id", QString("0x%1").arg(streamID, 2, 16, QChar('0')));
+		stream.insert("packets", double(demuxer.GetPacketCount(streamID)));
+		stream.insert("bytes", double(demuxer.GetByteCount(streamID)));
+		streams.append(stream);
+	}
+
+	pass.insert("streams", streams);
+
+	// damaged sectors skipped in resync mode
+	const std::vector<SectorExtent>& skipped = parser.GetSkippedSectors();
+	if (!skipped.empty())
+	{
+		QJsonArray ranges;
+
+		for (size_t index = 0; index < skipped.size(); ++index)
+		{
+			QJsonObject range;
+			range.insert("first", double(skipped[index].first));
+			range.insert("last", double(skipped[index].last));
+			ranges.append(range);
+		}
+
+		pass.insert("skipped_sectors", ranges);
+	}
+
+	passes_.append(pass);
+}
+
+bool RunReport::save(const QString& filename) const
+{
+	QJsonObject report;
+
+	report.insert("application", Utilities::APPLICATION_NAME);
+	report.insert("version", Utilities::APPLICATION_VERSION);
+	report.insert("source", sourcePath_);
+	report.insert("wall_ms", double(timer_.elapsed()));
+	report.insert("cpu_ms", double((CpuTime() - cpuStart_) / 1000000));
+	report.insert("peak_rss_kb", double(PeakMemory()));
+
+	if (AllocationCount() >= 0)
+		report.insert("allocations", double(AllocationCount() - allocationStart_));
+
+	QJsonObject stages;
+
+	for (int stage = 0; stage < STAGE_COUNT; ++stage)
+	{
+		QJsonObject times;
+		times.insert("wall_ms", double(stageWall_[stage] / 1000000));
+		times.insert("cpu_ms", double(stageCpu_[stage] / 1000000));
+		stages.insert(STAGE_NAMES[stage], times);
+	}
+
+	report.insert("stages", stages);
+	report.insert("passes", passes_);
+
+	QSaveFile file(filename);
+
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		fprintf(stderr, "Could not write the run report '%s'\n", qPrintable(filename));
+		return false;
+	}
+
+	file.write(QJsonDocument(report).toJson());
+	return file.commit();
+}
+
+// ----------------------------------------------------------------------------
+
+qint64 RunReport::CpuTime()
+{
+#if (defined(WIN32) || defined(WIN64))
+	FILETIME creation, exit, kernel, user;
+
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0;
+
+	ULARGE_INTEGER kernelTime, userTime;
+	kernelTime.LowPart = kernel.dwLowDateTime;
+	kernelTime.HighPart = kernel.dwHighDateTime;
+	userTime.LowPart = user.dwLowDateTime;
+	userTime.HighPart = user.dwHighDateTime;
+
+	// 100 ns units
+	return qint64(kernelTime.QuadPart + userTime.QuadPart) * 100;
+#else
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+	return (qint64(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000000
+		+ (qint64(usage.ru_utime.tv_usec) + usage.ru_stime.tv_usec) * 1000;
+#endif
+}
+
+qint64 RunReport::PeakMemory()
+{
+#if (defined(WIN32) || defined(WIN64))
+	PROCESS_MEMORY_COUNTERS counters;
+
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+
+	return qint64(counters.PeakWorkingSetSize / 1024);
+#else
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+#if defined(__APPLE__)
+	return usage.ru_maxrss / 1024; // bytes on Mac OS X
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+}
+
+qint64 RunReport::AllocationCount()
+{
+#ifdef CONFIG_ALLOC_STATS
+	return allocationCount.load();
+#else
+	return -1;
+#endif
+}
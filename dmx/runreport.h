@@ -0,0 +1,60 @@
+#ifndef RUN_REPORT_H
+#define RUN_REPORT_H
+
+#include <QString>
+#include <QJsonArray>
+#include <QElapsedTimer>
+#include <stdint.h>
+
+class VobParser;
+
+// Collects the timings and counters of a DMX run and writes them as JSON
+class RunReport
+{
+public:
+	enum Stage {STAGE_IFO_LOAD = 0, STAGE_VOB_MAP, STAGE_DEMUX, STAGE_WRITER_FLUSH, STAGE_CHAPTERS, STAGE_MUX_WAIT, STAGE_COUNT};
+
+	// Adds the wall and CPU time spent until stop() (or destruction) to a stage
+	class StageTimer
+	{
+	public:
+		StageTimer(RunReport& report, Stage stage);
+		~StageTimer();
+
+		// returns the wall time of the stage in ns
+		qint64 stop();
+
+	private:
+		RunReport& report_;
+		Stage stage_;
+		bool running_;
+		qint64 cpuStart_;
+		QElapsedTimer timer_;
+	};
+
+	RunReport();
+
+	void start(const QString& sourcePath);
+	void addPass(const QString& name, const VobParser& parser, qint64 demuxTime);
+	bool save(const QString& filename) const;
+
+	static QString FILENAME;
+
+	// CPU time used by the process in ns
+	static qint64 CpuTime();
+	// Peak resident memory of the process in KB
+	static qint64 PeakMemory();
+	// Number of operator new calls, -1 unless built with CONFIG_ALLOC_STATS
+	static qint64 AllocationCount();
+
+private:
+	QString sourcePath_;
+	QElapsedTimer timer_;
+	qint64 cpuStart_;
+	qint64 allocationStart_;
+	qint64 stageWall_[STAGE_COUNT];
+	qint64 stageCpu_[STAGE_COUNT];
+	QJsonArray passes_;
+};
+
+#endif // RUN_REPORT_H
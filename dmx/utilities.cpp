@@ -1,9 +1,83 @@
 #include <iostream>
 #include "utilities.h"
 
+#include <QThread>
+#include <QDateTime>
+#include <QThreadStorage>
+#include <QAtomicInteger>
+#include <QCryptographicHash>
+
+// SplitMix64, one generator per thread so no lock is needed
+struct UIDGenerator
+{
+	uint64_t state;
+
+	uint64_t next()
+	{
+		state += 0x9E3779B97F4A7C15ULL;
+		return Mix(state);
+	}
+
+	static uint64_t Mix(uint64_t value)
+	{
+		value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+		return value ^ (value >> 31);
+	}
+};
+
+static QThreadStorage<UIDGenerator*> uidGenerators;
+static QAtomicInteger<quint64> uidSeedCounter;
+
+// Different on each call in the process and on each run
+static uint64_t UIDEntropy()
+{
+	return uint64_t(QDateTime::currentMSecsSinceEpoch()) * 1000003
+		^ uint64_t(quintptr(QThread::currentThreadId()))
+		^ UIDGenerator::Mix(uidSeedCounter.fetchAndAddRelaxed(1) + 1);
+}
+
+static UIDGenerator& CurrentUIDGenerator()
+{
+	if (!uidGenerators.hasLocalData())
+	{
+		UIDGenerator *generator = new UIDGenerator;
+		// mixed so that close seeds do not give overlapping sequences
+		generator->state = UIDGenerator::Mix(UIDEntropy());
+		uidGenerators.setLocalData(generator);
+	}
+
+	return *uidGenerators.localData();
+}
+
+void Utilities::SeedUID(const QByteArray& discID, int16_t title, bool deterministic)
+{
+	QCryptographicHash hash (QCryptographicHash::Md5);
+	hash.addData(discID);
+	hash.addData(QByteArray::number(title));
+
+	const QByteArray digest = hash.result();
+	uint64_t seed = 0;
+	for (int i = 0; i < 8; ++i)
+		seed = (seed << 8) | uint8_t(digest.at(i));
+
+	if (!deterministic)
+		seed ^= UIDEntropy();
+
+	CurrentUIDGenerator().state = UIDGenerator::Mix(seed);
+}
+
 QString Utilities::CreateUID()
 {
-	return QString("%1").arg( uint32_t(rand() | (rand() << 16)) );
+	UIDGenerator& generator = CurrentUIDGenerator();
+
+	// 0 is not a valid UID
+	uint64_t uid;
+	do
+		uid = generator.next();
+	while (uid == 0);
+
+	return QString::number(qulonglong(uid));
 }
 
 QString Utilities::FormatTime(uint64_t a_time)
@@ -23,10 +97,20 @@ QString Utilities::FormatTime(uint64_t a_time)
 
 QString Utilities::EncodeHex(const unsigned char *buffer, unsigned int size)
 {
-	QString result;
+	static const char HEX_DIGITS[] = "0123456789abcdef";
+
+	if (size == 0)
+		return QString();
+
+	// "xx xx xx", no trailing space
+	QString result (size * 3 - 1, QChar(' '));
+	QChar *output = result.data();
 
-	for (unsigned i = 0; i < size; ++i)
-		result += QString("%1 ").arg(buffer[i], 2, 16, QChar('0'));
+	for (unsigned i = 0; i < size; ++i, output += 3)
+	{
+		output[0] = QChar(HEX_DIGITS[buffer[i] >> 4]);
+		output[1] = QChar(HEX_DIGITS[buffer[i] & 0x0F]);
+	}
 
-	return result.trimmed();
+	return result;
 }
@@ -2,6 +2,7 @@
 #define UTILITIES_H
 
 #include <QString>
+#include <QByteArray>
 #include <stdint.h>
 #include "dmx_project.h"
 
@@ -12,7 +13,11 @@ namespace Utilities
 	static const QString APPLICATION_NAME    ("DVDMenuXtractor: DMX - a fair-use tool");
 	static const QString APPLICATION_VERSION PROJECT_VERSION;
 
+	// Non zero 64 bits UID from a generator owned by the calling thread
 	QString CreateUID();
+	// Restart the UIDs of the calling thread for a title of a disc. Deterministic UIDs are
+	// the same on each run, otherwise some entropy is mixed in.
+	void SeedUID(const QByteArray& discID, int16_t title, bool deterministic);
 	QString FormatTime(uint64_t a_time);
 	QString EncodeHex(const unsigned char *buffer, unsigned size);
 }
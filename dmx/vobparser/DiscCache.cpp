@@ -0,0 +1,206 @@
+// ----------------------------------------------------------------------------
+#include <string.h>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+#include "DiscCache.h"
+// ----------------------------------------------------------------------------
+QDataStream & operator<<(QDataStream & out, const DiscCache::Entry & entry)
+{
+	return out << entry.name << entry.start << entry.size << entry.data;
+}
+// ----------------------------------------------------------------------------
+QDataStream & operator>>(QDataStream & in, DiscCache::Entry & entry)
+{
+	return in >> entry.name >> entry.start >> entry.size >> entry.data;
+}
+// ----------------------------------------------------------------------------
+DiscCache::DiscCache(const QString& directory)
+	:m_directory(directory)
+{
+}
+// ----------------------------------------------------------------------------
+QString DiscCache::DefaultDirectory()
+{
+	return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/discs";
+}
+// ----------------------------------------------------------------------------
+QByteArray DiscCache::SourceKey(const QString& source, dvd_reader_t *dvd)
+{
+	QCryptographicHash _hash(QCryptographicHash::Md5);
+	QFileInfo _source(source);
+
+	_hash.addData(QFile::encodeName(_source.absoluteFilePath()));
+
+	if (_source.isDir())
+	{
+		// a copy of the disc, the names, sizes and dates of its files
+		QDir _directory(_source.absoluteFilePath());
+		if (_directory.exists("VIDEO_TS"))
+			_directory.cd("VIDEO_TS");
+
+		QFileInfoList _files = _directory.entryInfoList(QDir::Files, QDir::Name);
+		for (int i = 0; i < _files.size(); i++)
+		{
+			_hash.addData(QFile::encodeName(_files.at(i).fileName()));
+			_hash.addData(QByteArray::number(_files.at(i).size()));
+			_hash.addData(QByteArray::number(_files.at(i).lastModified().toMSecsSinceEpoch()));
+		}
+	}
+	else if (_source.isFile())
+	{
+		// an image file
+		_hash.addData(QByteArray::number(_source.size()));
+		_hash.addData(QByteArray::number(_source.lastModified().toMSecsSinceEpoch()));
+	}
+
+	// a disc or an image, the volume identifiers only need a few sectors
+	char _volid[32];
+	unsigned char _volsetid[128];
+	if (DVDUDFVolumeInfo(dvd, _volid, sizeof(_volid), _volsetid, sizeof(_volsetid)) == 0)
+	{
+		_hash.addData(_volid, strlen(_volid));
+		_hash.addData(reinterpret_cast<const char *>(_volsetid), sizeof(_volsetid));
+	}
+
+	// the labels and the dates are not enough to tell discs apart, the IFO files
+	// read here are the first ones needed anyway
+	if (AddInfoFile(_hash, dvd, 0))
+		AddInfoFile(_hash, dvd, 1);
+
+	_hash.addData(QByteArray::number(VERSION));
+	return _hash.result();
+}
+// ----------------------------------------------------------------------------
+bool DiscCache::AddInfoFile(QCryptographicHash& hash, dvd_reader_t *dvd, int title)
+{
+	dvd_file_t *_file = DVDOpenFile(dvd, title, DVD_READ_INFO_FILE);
+	if (!_file)
+		return false;
+
+	const ssize_t _blocks = DVDFileSize(_file);
+	QByteArray _data;
+	ssize_t _read = -1;
+
+	if (_blocks > 0)
+	{
+		_data.resize(_blocks * DVD_VIDEO_LB_LEN);
+		_read = DVDReadBytes(_file, _data.data(), _data.size());
+	}
+	DVDCloseFile(_file);
+
+	if (_read <= 0)
+		return false;
+
+	hash.addData(_data.constData(), _read);
+	return true;
+}
+// ----------------------------------------------------------------------------
+QString DiscCache::SnapshotFilename(const QByteArray& discID) const
+{
+	return m_directory + "/" + QString(discID.toHex()) + ".snapshot";
+}
+// ----------------------------------------------------------------------------
+QString DiscCache::SourceFilename(const QByteArray& sourceKey) const
+{
+	return m_directory + "/" + QString(sourceKey.toHex()) + ".source";
+}
+// ----------------------------------------------------------------------------
+bool DiscCache::Load(const QByteArray& sourceKey, dvd_reader_t *dvd) const
+{
+	QFile _source(SourceFilename(sourceKey));
+	if (!_source.open(QIODevice::ReadOnly))
+		return false;
+
+	const QByteArray _discID = QByteArray::fromHex(_source.readAll().trimmed());
+
+	QFile _file(SnapshotFilename(_discID));
+	if (_discID.isEmpty() || !_file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream _in(&_file);
+	_in.setVersion(QDataStream::Qt_5_0);
+
+	quint32 _magic = 0, _version = 0;
+	QByteArray _storedID;
+	EntryList _entries;
+
+	_in >> _magic >> _version;
+	if (_magic != MAGIC || _version != VERSION)
+		return false;
+
+	_in >> _storedID >> _entries;
+	if (_in.status() != QDataStream::Ok || _storedID != _discID)
+		return false;
+
+	AddEntries(dvd, _entries);
+	return true;
+}
+// ----------------------------------------------------------------------------
+bool DiscCache::Save(const QByteArray& sourceKey, const QByteArray& discID, dvd_reader_t *dvd) const
+{
+	if (discID.isEmpty() || !QDir().mkpath(m_directory))
+		return false;
+
+	QSaveFile _file(SnapshotFilename(discID));
+	if (!_file.open(QIODevice::WriteOnly))
+		return false;
+
+	QDataStream _out(&_file);
+	_out.setVersion(QDataStream::Qt_5_0);
+	_out << MAGIC << VERSION << discID << Entries(dvd);
+
+	if (!_file.commit())
+		return false;
+
+	QSaveFile _source(SourceFilename(sourceKey));
+	if (!_source.open(QIODevice::WriteOnly))
+		return false;
+
+	_source.write(discID.toHex());
+	return _source.commit();
+}
+// ----------------------------------------------------------------------------
+DiscCache::EntryList DiscCache::Entries(dvd_reader_t *dvd)
+{
+	EntryList _entries;
+
+	for (int i = 0; i < DVDFileEntryCount(dvd); i++)
+	{
+		const char *_name;
+		const unsigned char *_data;
+		Entry _entry;
+
+		if (DVDGetFileEntry(dvd, i, &_name, &_entry.start, &_entry.size, &_data) != 0)
+			continue;
+
+		_entry.name = _name;
+		if (_data)
+			_entry.data = QByteArray(reinterpret_cast<const char *>(_data), _entry.size);
+
+		_entries.append(_entry);
+	}
+
+	return _entries;
+}
+// ----------------------------------------------------------------------------
+void DiscCache::AddEntries(dvd_reader_t *dvd, const EntryList& entries)
+{
+	for (int i = 0; i < entries.size(); i++)
+	{
+		const Entry & _entry = entries.at(i);
+
+		// a truncated IFO content is not used
+		const bool _complete = !_entry.data.isEmpty() && quint32(_entry.data.size()) == _entry.size;
+
+		DVDAddFileEntry(dvd, _entry.name.constData(), _entry.start, _entry.size,
+			_complete ? reinterpret_cast<const unsigned char *>(_entry.data.constData()) : NULL);
+	}
+}
+// ----------------------------------------------------------------------------
@@ -0,0 +1,58 @@
+// ----------------------------------------------------------------------------
+#ifndef _DISC_CACHE_H_
+#define _DISC_CACHE_H_
+// ----------------------------------------------------------------------------
+#include <QList>
+#include <QString>
+#include <QByteArray>
+#include <QCryptographicHash>
+
+#include "dvdread/dvd_reader.h"
+// ----------------------------------------------------------------------------
+/// Snapshots of the disc layout (file locations and IFO contents) kept
+/// between runs. Opening the same disc again still locates and reads
+/// VIDEO_TS.IFO and the first title set IFO to identify it, the UDF search
+/// and the reads of the other files are skipped.
+class DiscCache
+{
+public:
+	/// a file located by libdvdread, see DVDAddFileEntry
+	struct Entry
+	{
+		QByteArray name;
+		quint32 start;
+		quint32 size;
+		QByteArray data;
+	};
+	typedef QList<Entry> EntryList;
+
+	DiscCache(const QString& directory);
+
+	/// identify a source from its file system information and the content of the
+	/// VIDEO_TS.IFO and first title set IFO files, discs of a series share their labels
+	static QByteArray SourceKey(const QString& source, dvd_reader_t *dvd);
+	/// location in the user cache directory
+	static QString DefaultDirectory();
+
+	/// give the files of the snapshot of the source to the reader, false if there is none
+	bool Load(const QByteArray& sourceKey, dvd_reader_t *dvd) const;
+	/// write the snapshot of the files located by the reader, keyed by disc ID
+	bool Save(const QByteArray& sourceKey, const QByteArray& discID, dvd_reader_t *dvd) const;
+
+	static EntryList Entries(dvd_reader_t *dvd);
+	static void AddEntries(dvd_reader_t *dvd, const EntryList& entries);
+
+	static const quint32 MAGIC = 0x444D5843; // "DMXC"
+	static const quint32 VERSION = 2;
+
+private:
+	static bool AddInfoFile(QCryptographicHash& hash, dvd_reader_t *dvd, int title);
+
+	QString SnapshotFilename(const QByteArray& discID) const;
+	QString SourceFilename(const QByteArray& sourceKey) const;
+
+	QString m_directory;
+};
+// ----------------------------------------------------------------------------
+#endif
+// ----------------------------------------------------------------------------
@@ -1,4 +1,5 @@
 // ----------------------------------------------------------------------------
+#include <algorithm>
 #include "IFOContent.h"
 // ----------------------------------------------------------------------------
 // Macro to convert Binary Coded Decimal to Decimal
@@ -51,21 +52,15 @@ IFOContent::IFOContent(dvd_reader_t *dvdr, int16_t title)
 			// add each cell in a list
 			// order this list according to vob ID, cell ID
 			// for each cell, find the duration (and start time) from all menu PGCs
+			const CellAddressHashType addresses = IndexCellAddresses(*m_handle->menu_c_adt);
 			for(uint16_t i = 0; i < m_handle->pgci_ut->nr_of_lus; i++)
 			{
 				pgci_lu_t& lu = m_handle->pgci_ut->lu[i];
-				GetPGCCells(*lu.pgcit, *m_handle->menu_c_adt, &CellsHash);
+				GetPGCCells(*lu.pgcit, addresses, &CellsHash);
 			}
 
 			// Transfer hash map to the list to be sorted
-			m_langCellsList.clear();
-			
-			for(CellsHashType::iterator it = CellsHash.begin(); it != CellsHash.end(); ++it )
-			{
-				m_langCellsList.append(it.value());
-			}
-
-			m_langCellsList.arrange();
+			m_langCellsList.assign(CellsHash);
 		}
 	}
 	else
@@ -92,21 +87,15 @@ IFOContent::IFOContent(dvd_reader_t *dvdr, int16_t title)
 			// add each cell in a list
 			// order this list according to vob ID, cell ID
 			// for each cell, find the duration (and start time) from all menu PGCs
+			const CellAddressHashType addresses = IndexCellAddresses(*m_handle->menu_c_adt);
 			for(int i = 0; i < m_handle->pgci_ut->nr_of_lus; i++)
 			{
 				pgci_lu_t& lu = m_handle->pgci_ut->lu[i];
-				GetPGCCells(*lu.pgcit, *m_handle->menu_c_adt, &CellsHash);
+				GetPGCCells(*lu.pgcit, addresses, &CellsHash);
 			}
 
 			// Transfer hash map to the list to be sorted
-			m_langCellsList.clear();
-			CellsHashType::iterator it;
-			for( it = CellsHash.begin(); it != CellsHash.end(); ++it )
-			{
-				m_langCellsList.append(it.value());
-			}
-
-			m_langCellsList.arrange();
+			m_langCellsList.assign(CellsHash);
 		}
 
 		// handle the list of cells with their ID and sectors
@@ -116,25 +105,16 @@ IFOContent::IFOContent(dvd_reader_t *dvdr, int16_t title)
 			// add each cell in a list
 			// order this list according to vob ID, cell ID
 			// for each cell, find the duration (and start time) from all PGCs
-			GetPGCCells(*m_handle->vts_pgcit, *m_handle->vts_c_adt, &CellsHash);
+			GetPGCCells(*m_handle->vts_pgcit, IndexCellAddresses(*m_handle->vts_c_adt), &CellsHash);
 
 			// Transfer hash map to the list to be sorted
-			m_CellsList.clear();
-			
-			for(CellsHashType::iterator it = CellsHash.begin(); it != CellsHash.end(); ++it )
-			{
-				m_CellsList.append(it.value());
-			}
-
-			m_CellsList.arrange();
+			m_CellsList.assign(CellsHash);
 		}
 	}
 }
 // ----------------------------------------------------------------------------
-void IFOContent::GetPGCCells(const pgcit_t & pgcit, const c_adt_t & adt, CellsHashType * CellsHash)
+void IFOContent::GetPGCCells(const pgcit_t & pgcit, const CellAddressHashType & addresses, CellsHashType * CellsHash)
 {
-	CellListElem* cle;
-
 	for(int j=0; j < pgcit.nr_of_pgci_srp; j++)
 	{
 		pgci_srp_t& srp = pgcit.pgci_srp[j];
@@ -145,38 +125,31 @@ void IFOContent::GetPGCCells(const pgcit_t & pgcit, const c_adt_t & adt, CellsHa
 
 			if (CellsHash->find(MAKE_CELLS_KEY(vob_id, cell_id)) == CellsHash->end())
 			{
-				size_t cell_nr = adt.last_byte;
-				cell_nr -= 7;
-				cell_nr /= sizeof(cell_adr_t);
-				for (size_t l=0; l < cell_nr; l++)
+				CellAddressHashType::const_iterator address = addresses.find(MAKE_CELLS_KEY(vob_id, cell_id));
+				if (address != addresses.end())
 				{
-					if (adt.cell_adr_table[l].vob_id == vob_id && adt.cell_adr_table[l].cell_id == cell_id)
-					{
-						cle = new CellListElem();
-						(*CellsHash)[MAKE_CELLS_KEY(vob_id, cell_id)] = cle;
+					CellListElem *cle = &(*CellsHash)[MAKE_CELLS_KEY(vob_id, cell_id)];
 
-						cle->vobid = vob_id;
-						cle->cellid = cell_id;
+					cle->vobid = vob_id;
+					cle->cellid = cell_id;
 
-						cle->start_sector = adt.cell_adr_table[l].start_sector;
-						cle->last_sector = adt.cell_adr_table[l].last_sector;
-						cle->selected = true; // all cells selected for the moment
-						cle->found = false;
-						/* debug	* /			cle->found = true;*/
+					cle->start_sector = address.value().first;
+					cle->last_sector = address.value().last;
+					cle->selected = true; // all cells selected until IFOFile::SelectCells
+					cle->found = false;
+					/* debug	* /			cle->found = true;*/
 
-						cle->nb_frames = dvdtime2frame(&srp.pgc->cell_playback[k].playback_time, cle->frame_dur);
-						cle->isStill = (srp.pgc->cell_playback[k].still_time > 0);
-						if (cle->isStill)
-						{
-							if (srp.pgc->cell_playback[k].still_time == 0xFF) {
-							  qWarning(qPrintable(QString("Still cell (%1.%2) detected with infinite duration !").arg(vob_id).arg(cell_id)));
-							} else {
-							  qWarning(qPrintable(QString("Still cell (%1.%2) detected. Assuming there is just one frame.").arg(vob_id).arg(cell_id)));
-								cle->nb_frames = 1; // maybe not true ?
-								cle->frame_dur = srp.pgc->cell_playback[k].still_time * 1000.0 / cle->nb_frames;
-							}
+					cle->nb_frames = dvdtime2frame(&srp.pgc->cell_playback[k].playback_time, cle->frame_dur);
+					cle->isStill = (srp.pgc->cell_playback[k].still_time > 0);
+					if (cle->isStill)
+					{
+						if (srp.pgc->cell_playback[k].still_time == 0xFF) {
+						  qWarning(qPrintable(QString("Still cell (%1.%2) detected with infinite duration !").arg(vob_id).arg(cell_id)));
+						} else {
+						  qWarning(qPrintable(QString("Still cell (%1.%2) detected. Assuming there is just one frame.").arg(vob_id).arg(cell_id)));
+							cle->nb_frames = 1; // maybe not true ?
+							cle->frame_dur = srp.pgc->cell_playback[k].still_time * 1000.0 / cle->nb_frames;
 						}
-						break;
 					}
 				}
 			}
@@ -184,6 +157,38 @@ void IFOContent::GetPGCCells(const pgcit_t & pgcit, const c_adt_t & adt, CellsHa
 	}
 }
 // ----------------------------------------------------------------------------
+CellAddressHashType IFOContent::IndexCellAddresses(const c_adt_t & adt)
+{
+	CellAddressHashType result;
+
+	size_t cell_nr = adt.last_byte;
+	cell_nr -= 7;
+	cell_nr /= sizeof(cell_adr_t);
+	result.reserve(int(cell_nr));
+
+	for (size_t l=0; l < cell_nr; l++)
+	{
+		// a cell of an interleaved block has one entry per interleaved unit
+		const cell_adr_t & address = adt.cell_adr_table[l];
+		const int key = MAKE_CELLS_KEY(address.vob_id, address.cell_id);
+		CellAddressHashType::iterator extent = result.find(key);
+		if (extent == result.end())
+		{
+			SectorExtent sectors;
+			sectors.first = address.start_sector;
+			sectors.last = address.last_sector;
+			result.insert(key, sectors);
+		}
+		else
+		{
+			extent.value().first = std::min(extent.value().first, address.start_sector);
+			extent.value().last = std::max(extent.value().last, address.last_sector);
+		}
+	}
+
+	return result;
+}
+// ----------------------------------------------------------------------------
 uint8_t IFOContent::FindAudioStream(uint8_t streamID, bool menu) const
 {
 	assert(m_handle != NULL);
@@ -10,7 +10,9 @@
 // ----------------------------------------------------------------------------
 typedef std::vector<uint8_t> IdArray;
 
-typedef QHash<int, CellListElem *> CellsHashType;
+typedef QHash<int, CellListElem> CellsHashType;
+// sectors of each cell, over all the pieces of the interleaved ones
+typedef QHash<int, SectorExtent> CellAddressHashType;
 typedef std::vector<const audio_attr_t*> AudioTrackList;
 typedef std::vector<const subp_attr_t*> SubtitleTrackList;
 
@@ -20,16 +22,37 @@ class IFOException { };
 class IFOFileIOException : public IFOException { };
 class IFOInvalidFileFormatException : public IFOException { };
 // ----------------------------------------------------------------------------
-typedef QList<CellListElem*> CellsListBaseType;
-class CellsListType : public CellsListBaseType
+// Cells sorted by (vob_id, cell_id), stored contiguously and looked up by binary search
+class CellsListType
 {
 public:
+	typedef std::vector<CellListElem> StorageType;
+	typedef StorageType::iterator iterator;
+	typedef StorageType::const_iterator const_iterator;
+
+	void assign(const CellsHashType & cells);
 	void arrange();
+	void clear() { m_cells.clear(); }
+
+	size_t size() const { return m_cells.size(); }
+	bool empty() const { return m_cells.empty(); }
+	iterator begin() { return m_cells.begin(); }
+	iterator end() { return m_cells.end(); }
+	const_iterator begin() const { return m_cells.begin(); }
+	const_iterator end() const { return m_cells.end(); }
+
+	// the run-time state of a cell (found) can be updated through a const list
 	CellListElem* at(uint16_t vob_id, uint8_t cell_id) const;
 	const CellListElem* at(const cell_position_t & position) const;
 
-	// comperator for qSort()
-	static int cellListElemCompare(const CellListElem *arg1, const CellListElem *arg2);
+	// sectors of the selected cells, the orphaned cells are not in the list
+	ReadPlan GetReadPlan() const;
+
+	// comparator for std::sort()
+	static bool cellListElemLess(const CellListElem & arg1, const CellListElem & arg2);
+
+private:
+	StorageType m_cells;
 };
 // ----------------------------------------------------------------------------
 class IFOContent 
@@ -53,7 +76,10 @@ public:
 	IdArray FindSubStream(uint8_t streamID, bool menu) const;
 	uint8_t FindAudioStream(uint8_t streamID, bool menu) const;
 	
-	void GetPGCCells(const pgcit_t & pgcit, const c_adt_t & adt, CellsHashType * CellsHash);
+	void GetPGCCells(const pgcit_t & pgcit, const CellAddressHashType & addresses, CellsHashType * CellsHash);
+
+	// index the cell address table by MAKE_CELLS_KEY(vob_id, cell_id), a cell of an interleaved block spans all of its entries
+	static CellAddressHashType IndexCellAddresses(const c_adt_t & adt);
 
 	int16_t m_title;
 	AudioTrackList m_langAudio;
@@ -1,9 +1,16 @@
 // ----------------------------------------------------------------------------
+#include <QCryptographicHash>
+#include <QThreadPool>
+#include <QRunnable>
+#include <algorithm>
+
 #include "IFOFile.h"
 #include "iso/iso_lang.h"
 #include "dvdread/ifo_print.h"
+#include "dvdread/nav_types.h"
 // ----------------------------------------------------------------------------
-IFOFile::IFOFile(const QString& filename)
+IFOFile::IFOFile(const QString& filename, IfoLoadMode mode, const QString& cacheDirectory)
+	:m_cacheDirectory(cacheDirectory), m_savedEntries(0)
 {	
 	m_dvd = DVDOpen(QFile::encodeName(filename));
 	
@@ -11,34 +18,32 @@ IFOFile::IFOFile(const QString& filename)
 		throw IFOInvalidFileFormatException();
 	}
 
+	if (!m_cacheDirectory.isEmpty())
+	{
+		m_sourceKey = DiscCache::SourceKey(filename, m_dvd);
+		DiscCache(m_cacheDirectory).Load(m_sourceKey, m_dvd);
+		m_savedEntries = DVDFileEntryCount(m_dvd);
+	}
+
 	try {
-		m_ifos.append(new IFOContent(m_dvd, 0));		
+		m_ifos.load(m_dvd, filename, mode);
 	}
 	catch (...)	{
-		qCritical("Cannot open VIDEO_TS.IFO.");
+		m_ifos.clear();
+		DVDClose(m_dvd);
 		throw;
 	}
 
-	IFOContent *_ifo = m_ifos.getIfoContent(0);
-
-	if (_ifo && _ifo->Handle().vmgi_mat)
-	{
-		for (int i = 1; i <= _ifo->Handle().vmgi_mat->vmg_nr_of_title_sets; i++)
-		{
-			try {
-				m_ifos.append(new IFOContent(m_dvd,i));
-			}
-			catch (...)	{
-			  qCritical(qPrintable(QString("Cannot open VTS_%1_X.IFO").arg(i)));
-			}
-		}
-	}
+	SaveDiscCache();
 }
 // ----------------------------------------------------------------------------
 IFOFile::~IFOFile()
 {
-	for (int i = 0; i < m_ifos.size(); i++)
-		delete m_ifos.at(i);
+	// keep the title sets loaded since the last save
+	SaveDiscCache();
+
+	// the IFO handles refer to the reader
+	m_ifos.clear();
 	
 	if (m_dvd)
 	{
@@ -46,18 +51,47 @@ IFOFile::~IFOFile()
 	}
 }
 // ----------------------------------------------------------------------------
+void IFOFile::SaveDiscCache()
+{
+	if (m_cacheDirectory.isEmpty())
+		return;
+
+	// locate the VOB files too, the parsers open them with their own reader
+	dvd_stat_t _stat;
+	for (int16_t _title = 0; _title <= NumberOfTitles(); _title++)
+	{
+		DVDFileStat(m_dvd, _title, DVD_READ_MENU_VOBS, &_stat);
+		if (_title)
+			DVDFileStat(m_dvd, _title, DVD_READ_TITLE_VOBS, &_stat);
+	}
+
+	// the disc ID reads the first title set IFOs, they are kept in the snapshot
+	const QByteArray _discID = DiscID();
+
+	if (DVDFileEntryCount(m_dvd) == m_savedEntries)
+		return;
+
+	if (DiscCache(m_cacheDirectory).Save(m_sourceKey, _discID, m_dvd))
+		m_savedEntries = DVDFileEntryCount(m_dvd);
+}
+// ----------------------------------------------------------------------------
+void IFOFile::PrepareReader(dvd_reader_t *dvd) const
+{
+	DiscCache::AddEntries(dvd, DiscCache::Entries(m_dvd));
+}
+// ----------------------------------------------------------------------------
 const pgc_t *IFOFile::FirstPlayPGC() const
 {
-	if (m_ifos.at(0))
-		return m_ifos.at(0)->Handle().first_play_pgc;
+	if (m_ifos.getIfoContent(0))
+		return m_ifos.getIfoContent(0)->Handle().first_play_pgc;
 	else
 		return NULL;
 }
 // ----------------------------------------------------------------------------
 const tt_srpt_t *IFOFile::TitleMap() const
 {
-	if (m_ifos.at(0))
-		return m_ifos.at(0)->Handle().tt_srpt;
+	if (m_ifos.getIfoContent(0))
+		return m_ifos.getIfoContent(0)->Handle().tt_srpt;
 	else
 		return NULL;
 }
@@ -94,27 +128,19 @@ const pgcit_t *IFOFile::VtsPGCs(unsigned int title) const
 // ----------------------------------------------------------------------------
 const int16_t IFOFile::NumberOfTitles() const
 {
-	if (m_ifos.count() && m_ifos.at(0)->Handle().vmgi_mat)
-		return m_ifos.at(0)->Handle().vmgi_mat->vmg_nr_of_title_sets;
+	IFOContent *_ifo = m_ifos.getIfoContent(0);
+	if (_ifo && _ifo->Handle().vmgi_mat)
+		return _ifo->Handle().vmgi_mat->vmg_nr_of_title_sets;
 	return 0;
 }
 // ----------------------------------------------------------------------------
-int CellsListType::cellListElemCompare(const CellListElem *arg1, const CellListElem *arg2)
+bool CellsListType::cellListElemLess(const CellListElem & arg1, const CellListElem & arg2)
 {
-	const CellListElem* cle1 = arg1;
-	const CellListElem* cle2 = arg2;
-
-	return (cle1->vobid > cle2->vobid) ? 1 :
-		(cle1->vobid < cle2->vobid) ? -1 :
-			(cle1->cellid > cle2->cellid) ? 1 : 
-				(cle1->cellid < cle2->cellid) ? -1 :
-					0;
+	return (arg1.vobid < arg2.vobid) || (arg1.vobid == arg2.vobid && arg1.cellid < arg2.cellid);
 }
 // ----------------------------------------------------------------------------
 const CellsListType* IFOFile::GetCellsList(unsigned int title, bool menu)
 {
-	CellsHashType CellsHash;
-
 	IFOContent *ifoc = m_ifos.getIfoContent(title);
 	if (!ifoc)
 		return NULL;
@@ -125,6 +151,194 @@ const CellsListType* IFOFile::GetCellsList(unsigned int title, bool menu)
 		return &ifoc->m_CellsList;
 }
 // ----------------------------------------------------------------------------
+// Check that the sector read at the start of a cell is a navigation pack of this cell
+static bool IsCellNavPack(const unsigned char * sector, const CellListElem & cell)
+{
+	// pack header, system header, then PCI and DSI private stream 2 packets
+	static const unsigned char _packStart[] = {0x00, 0x00, 0x01, 0xBA};
+	static const unsigned char _dsiStart[] = {0x00, 0x00, 0x01, 0xBF};
+
+	if (memcmp(sector, _packStart, sizeof(_packStart)) != 0 || memcmp(sector + DSI_START_BYTE - 7, _dsiStart, sizeof(_dsiStart)) != 0)
+		return false;
+
+	// dsi_gi.vobu_vob_idn and dsi_gi.vobu_c_idn
+	const unsigned char * _dsi = sector + DSI_START_BYTE;
+	const unsigned int _vobid = (_dsi[24] << 8) | _dsi[25];
+	const unsigned int _cellid = _dsi[27];
+
+	return _vobid == cell.vobid && _cellid == cell.cellid;
+}
+// ----------------------------------------------------------------------------
+size_t IFOFile::FindCells(unsigned int title, bool menu)
+{
+	IFOContent *_ifo = m_ifos.getIfoContent(title);
+	if (!_ifo)
+		return 0;
+
+	CellsListType & _cells = menu ? _ifo->m_langCellsList : _ifo->m_CellsList;
+	const vobu_admap_t *_admap = menu ? _ifo->Handle().menu_vobu_admap : _ifo->Handle().vts_vobu_admap;
+
+	const uint32_t *_vobuBegin = NULL, *_vobuEnd = NULL;
+	if (_admap && _admap->last_byte + 1 > VOBU_ADMAP_SIZE)
+	{
+		_vobuBegin = _admap->vobu_start_sectors;
+		_vobuEnd = _vobuBegin + (_admap->last_byte + 1 - VOBU_ADMAP_SIZE) / sizeof(uint32_t);
+	}
+
+	size_t _found = 0;
+	dvd_file_t *_vobs = DVDOpenFile(m_dvd, title, menu ? DVD_READ_MENU_VOBS : DVD_READ_TITLE_VOBS);
+	const uint32_t _vobsSize = _vobs ? DVDFileSize(_vobs) : 0;
+	unsigned char _sector[DVD_VIDEO_LB_LEN];
+
+	for (CellsListType::iterator _cell = _cells.begin(); _cell != _cells.end(); ++_cell)
+	{
+		_cell->found = false;
+
+		if (!_cell->selected)
+			continue;
+
+		// truncated or missing VOB files
+		if (_cell->last_sector >= _vobsSize || _cell->start_sector > _cell->last_sector)
+			continue;
+
+		if (_vobuBegin)
+		{
+			const uint32_t *_vobu = std::lower_bound(_vobuBegin, _vobuEnd, _cell->start_sector);
+			if (_vobu == _vobuEnd || *_vobu != _cell->start_sector)
+				continue;
+		}
+
+		if (DVDReadBlocks(_vobs, _cell->start_sector, 1, _sector) != 1 || !IsCellNavPack(_sector, *_cell))
+			continue;
+
+		_cell->found = true;
+		_found++;
+	}
+
+	if (_vobs)
+		DVDCloseFile(_vobs);
+
+	return _found;
+}
+// ----------------------------------------------------------------------------
+// Select the cells of a PGC inside the range of cell numbers
+static size_t SelectPGCCells(const pgcit_t * pgcit, const PgcSelection & selection, CellsListType & cells)
+{
+	size_t _selected = 0;
+
+	if (!pgcit)
+		return 0;
+
+	for (int i = 0; i < pgcit->nr_of_pgci_srp; i++)
+	{
+		if (selection.pgc && selection.pgc != i + 1)
+			continue;
+
+		const pgc_t *_pgc = pgcit->pgci_srp[i].pgc;
+		if (!_pgc || !_pgc->cell_position)
+			continue;
+
+		for (int j = 0; j < _pgc->nr_of_cells; j++)
+		{
+			if (j + 1 < selection.firstCell || (selection.lastCell && j + 1 > selection.lastCell))
+				continue;
+
+			CellListElem *_cell = cells.at(_pgc->cell_position[j].vob_id_nr, _pgc->cell_position[j].cell_nr);
+			if (_cell && !_cell->selected)
+			{
+				_cell->selected = true;
+				_selected++;
+			}
+		}
+	}
+
+	return _selected;
+}
+// ----------------------------------------------------------------------------
+// Unselect the cells of the other angles in the angle blocks of the PGCs. A block
+// with fewer angles keeps its first one.
+static size_t UnselectOtherAngles(const pgcit_t * pgcit, unsigned int angle, CellsListType & cells)
+{
+	size_t _unselected = 0;
+
+	if (!pgcit)
+		return 0;
+
+	for (int i = 0; i < pgcit->nr_of_pgci_srp; i++)
+	{
+		const pgc_t *_pgc = pgcit->pgci_srp[i].pgc;
+		if (!_pgc || !_pgc->cell_playback || !_pgc->cell_position)
+			continue;
+
+		int _first = 0;
+		for (int j = 0; j < _pgc->nr_of_cells; j++)
+		{
+			const cell_playback_t & _playback = _pgc->cell_playback[j];
+			if (_playback.block_type != BLOCK_TYPE_ANGLE_BLOCK)
+				continue;
+
+			if (_playback.block_mode == BLOCK_MODE_FIRST_CELL)
+				_first = j;
+			if (_playback.block_mode != BLOCK_MODE_LAST_CELL)
+				continue;
+
+			const unsigned int _angles = j - _first + 1;
+			const int _kept = _first + ((angle <= _angles) ? angle - 1 : 0);
+
+			for (int k = _first; k <= j; k++)
+			{
+				CellListElem *_cell = cells.at(_pgc->cell_position[k].vob_id_nr, _pgc->cell_position[k].cell_nr);
+				if (k != _kept && _cell && _cell->selected)
+				{
+					_cell->selected = false;
+					_unselected++;
+				}
+			}
+		}
+	}
+
+	return _unselected;
+}
+// ----------------------------------------------------------------------------
+size_t IFOFile::SelectCells(unsigned int title, bool menu, const PgcSelectionList& selection, unsigned int angle)
+{
+	IFOContent *_ifo = m_ifos.getIfoContent(title);
+	if (!_ifo)
+		return 0;
+
+	CellsListType & _cells = menu ? _ifo->m_langCellsList : _ifo->m_CellsList;
+
+	for (CellsListType::iterator _cell = _cells.begin(); _cell != _cells.end(); ++_cell)
+		_cell->selected = selection.empty();
+
+	size_t _selected = selection.empty() ? _cells.size() : 0;
+
+	for (PgcSelectionList::const_iterator _item = selection.begin(); _item != selection.end(); ++_item)
+	{
+		if (!menu)
+		{
+			_selected += SelectPGCCells(_ifo->Handle().vts_pgcit, *_item, _cells);
+			continue;
+		}
+
+		const pgci_ut_t *_units = _ifo->Handle().pgci_ut;
+		if (!_units)
+			continue;
+
+		for (int i = 0; i < _units->nr_of_lus; i++)
+		{
+			if (!_item->languageUnit || _item->languageUnit == i + 1)
+				_selected += SelectPGCCells(_units->lu[i].pgcit, *_item, _cells);
+		}
+	}
+
+	// the menus have no angle block
+	if (angle && !menu)
+		_selected -= UnselectOtherAngles(_ifo->Handle().vts_pgcit, angle, _cells);
+
+	return _selected;
+}
+// ----------------------------------------------------------------------------
 const AudioTrackList & IFOFile::AudioTracks(unsigned int title, bool menu) const
 {
 	IFOContent *_ifo = m_ifos.getIfoContent(title);
@@ -249,16 +463,213 @@ IdArray IFOFile::GetSubsId(uint8_t streamID, uint8_t title, bool menu) const
 	return _ifo->FindSubStream(streamID, menu);
 }
 // ----------------------------------------------------------------------------
+QByteArray IFOFile::DiscID() const
+{
+	unsigned char _discId[16];
+
+	if (DVDDiscID(m_dvd, _discId) < 0)
+		return QByteArray();
+
+	return QByteArray((const char *)_discId, sizeof(_discId));
+}
+// ----------------------------------------------------------------------------
+QByteArray IFOFile::InfoFileHash(unsigned int title) const
+{
+	dvd_file_t *_file = DVDOpenFile(m_dvd, title, DVD_READ_INFO_FILE);
+	if (!_file)
+		return QByteArray();
+
+	ssize_t _blocks = DVDFileSize(_file);
+	if (_blocks < 0)
+	{
+		DVDCloseFile(_file);
+		return QByteArray();
+	}
+
+	QByteArray _data;
+	_data.resize(_blocks * DVD_VIDEO_LB_LEN);
+
+	ssize_t _read = DVDReadBytes(_file, _data.data(), _data.size());
+	DVDCloseFile(_file);
+
+	if (_read < 0)
+		return QByteArray();
+
+	_data.resize(_read);
+	return QCryptographicHash::hash(_data, QCryptographicHash::Md5);
+}
+// ----------------------------------------------------------------------------
+class IfoLoadTask : public QRunnable
+{
+public:
+	IfoLoadTask(IfoHandleList & list, int16_t title)
+		:m_list(list), m_title(title)
+	{
+	}
+
+	void run()
+	{
+		m_list.loadParallel(m_title);
+	}
+
+private:
+	IfoHandleList & m_list;
+	int16_t m_title;
+};
+// ----------------------------------------------------------------------------
+IfoHandleList::IfoHandleList()
+	:m_dvd(NULL), m_mode(IFO_LOAD_EAGER)
+{
+}
+// ----------------------------------------------------------------------------
+IfoHandleList::~IfoHandleList()
+{
+	clear();
+}
+// ----------------------------------------------------------------------------
+void IfoHandleList::load(dvd_reader_t *dvd, const QString& filename, IfoLoadMode mode)
+{
+	clear();
+
+	m_dvd = dvd;
+	m_filename = filename;
+	m_mode = mode;
+
+	IFOContent *_vmg = loadContent(m_dvd, 0);
+	if (!_vmg)
+	{
+		qCritical("Cannot open VIDEO_TS.IFO.");
+		throw IFOInvalidFileFormatException();
+	}
+
+	const int16_t _titles = _vmg->Handle().vmgi_mat ? _vmg->Handle().vmgi_mat->vmg_nr_of_title_sets : 0;
+
+	m_contents.assign(_titles + 1, NULL);
+	m_loaded.assign(_titles + 1, false);
+	m_contents[0] = _vmg;
+	m_loaded[0] = true;
+
+	if (mode == IFO_LOAD_EAGER)
+	{
+		for (int16_t i = 1; i <= _titles; i++)
+		{
+			m_contents[i] = loadContent(m_dvd, i);
+			m_loaded[i] = true;
+		}
+	}
+	else if (mode == IFO_LOAD_PARALLEL)
+	{
+		m_entries = DiscCache::Entries(m_dvd);
+		m_freeReaders.push_back(m_dvd);
+
+		// DVDOpen sets up the global input functions of libdvdread, the other
+		// readers are opened here before any of them is read from
+		QThreadPool _pool;
+		const int _threads = std::min<int>(_pool.maxThreadCount(), _titles);
+		for (int i = 1; i < _threads; i++)
+			openReader();
+
+		// one thread per reader, a task always finds a free one
+		_pool.setMaxThreadCount(std::max<int>(int(m_freeReaders.size()), 1));
+		for (int16_t i = 1; i <= _titles; i++)
+			_pool.start(new IfoLoadTask(*this, i));
+		_pool.waitForDone();
+
+		m_freeReaders.clear();
+		m_entries.clear();
+
+		// collect the files located by the other readers
+		for (size_t _index = 0; _index < m_readers.size(); _index++)
+			DiscCache::AddEntries(m_dvd, DiscCache::Entries(m_readers[_index]));
+	}
+}
+// ----------------------------------------------------------------------------
+void IfoHandleList::clear()
+{
+	for (size_t _index = 0; _index < m_contents.size(); _index++)
+		delete m_contents[_index];
+	m_contents.clear();
+	m_loaded.clear();
+
+	for (size_t _index = 0; _index < m_readers.size(); _index++)
+		DVDClose(m_readers[_index]);
+	m_readers.clear();
+	m_freeReaders.clear();
+}
+// ----------------------------------------------------------------------------
 IFOContent * IfoHandleList::getIfoContent(int16_t title) const
 {
-	for (size_type _index = 0; _index < size(); _index++)
+	if (title < 0 || size_t(title) >= m_contents.size())
+		return NULL;
+
+	QMutexLocker _locker(&m_mutex);
+
+	if (!m_loaded[title])
 	{
-		if (at(_index)->m_title == title)
-			return at(_index);
+		m_contents[title] = loadContent(m_dvd, title);
+		m_loaded[title] = true;
+	}
+
+	return m_contents[title];
+}
+// ----------------------------------------------------------------------------
+IFOContent * IfoHandleList::loadContent(dvd_reader_t *dvd, int16_t title)
+{
+	try {
+		return new IFOContent(dvd, title);
+	}
+	catch (...)	{
+		if (title)
+			qCritical(qPrintable(QString("Cannot open VTS_%1_X.IFO").arg(title)));
 	}
 	return NULL;
 }
 // ----------------------------------------------------------------------------
+void IfoHandleList::loadParallel(int16_t title)
+{
+	dvd_reader_t *_dvd = acquireReader();
+
+	IFOContent *_ifo = _dvd ? loadContent(_dvd, title) : NULL;
+
+	if (_dvd)
+		releaseReader(_dvd);
+
+	QMutexLocker _locker(&m_mutex);
+	m_contents[title] = _ifo;
+	m_loaded[title] = true;
+}
+// ----------------------------------------------------------------------------
+void IfoHandleList::openReader()
+{
+	// kept open until clear(), the IFO handles loaded with it refer to it
+	dvd_reader_t *_dvd = DVDOpen(QFile::encodeName(m_filename));
+	if (_dvd)
+	{
+		DiscCache::AddEntries(_dvd, m_entries);
+		m_readers.push_back(_dvd);
+		m_freeReaders.push_back(_dvd);
+	}
+}
+// ----------------------------------------------------------------------------
+dvd_reader_t * IfoHandleList::acquireReader()
+{
+	QMutexLocker _locker(&m_readersMutex);
+
+	if (m_freeReaders.empty())
+		return NULL;
+
+	dvd_reader_t *_dvd = m_freeReaders.back();
+	m_freeReaders.pop_back();
+	return _dvd;
+}
+// ----------------------------------------------------------------------------
+void IfoHandleList::releaseReader(dvd_reader_t *dvd)
+{
+	QMutexLocker _locker(&m_readersMutex);
+	m_freeReaders.push_back(dvd);
+}
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
 const CellListElem* CellsListType::at(const cell_position_t & position) const
 {
 	return at(position.vob_id_nr, position.cell_nr);
@@ -266,35 +677,77 @@ const CellListElem* CellsListType::at(const cell_position_t & position) const
 // ----------------------------------------------------------------------------
 CellListElem* CellsListType::at(uint16_t vob_id, uint8_t cell_id) const
 {
-	CellsListType::const_iterator node = begin();
-	while (node != end())
+	CellListElem key;
+	key.vobid = vob_id;
+	key.cellid = cell_id;
+
+	const_iterator node = std::lower_bound(m_cells.begin(), m_cells.end(), key, &CellsListType::cellListElemLess);
+
+	if (node == m_cells.end() || node->vobid != vob_id || node->cellid != cell_id)
+		return NULL;
+
+	return const_cast<CellListElem *>(&*node);
+}
+// ----------------------------------------------------------------------------
+void CellsListType::assign(const CellsHashType & cells)
+{
+	m_cells.clear();
+	m_cells.reserve(cells.size());
+
+	for (CellsHashType::const_iterator it = cells.constBegin(); it != cells.constEnd(); ++it)
+		m_cells.push_back(it.value());
+
+	arrange();
+}
+// ----------------------------------------------------------------------------
+static bool SectorExtentLess(const SectorExtent & arg1, const SectorExtent & arg2)
+{
+	return arg1.first < arg2.first;
+}
+// ----------------------------------------------------------------------------
+ReadPlan CellsListType::GetReadPlan() const
+{
+	ReadPlan _extents;
+	_extents.reserve(m_cells.size());
+
+	for (const_iterator cell = m_cells.begin(); cell != m_cells.end(); ++cell)
 	{
-		CellListElem *cell = *node;
-		
-		if (cell->cellid == cell_id && cell->vobid == vob_id)
-			return cell;
-		
-		++node;
+		if (!cell->selected || cell->last_sector < cell->start_sector)
+			continue;
+
+		SectorExtent _extent;
+		_extent.first = cell->start_sector;
+		_extent.last = cell->last_sector;
+		_extents.push_back(_extent);
 	}
-	
-	return NULL;
+
+	// the cells are sorted by ID, not by position, and the angles share sectors
+	std::sort(_extents.begin(), _extents.end(), &SectorExtentLess);
+
+	ReadPlan _plan;
+	for (ReadPlan::const_iterator extent = _extents.begin(); extent != _extents.end(); ++extent)
+	{
+		if (!_plan.empty() && extent->first <= _plan.back().last + 1)
+			_plan.back().last = std::max(_plan.back().last, extent->last);
+		else
+			_plan.push_back(*extent);
+	}
+
+	return _plan;
 }
 // ----------------------------------------------------------------------------
 void CellsListType::arrange()
 {
-	qSort(begin(), end(), &CellsListType::cellListElemCompare);
+	std::sort(m_cells.begin(), m_cells.end(), &CellsListType::cellListElemLess);
 
 	// make the timecodes continuous
 	int64_t timecode = 0;
-	CellsListType::const_iterator node = begin();
-	while (node != end())
+	for (iterator cell = m_cells.begin(); cell != m_cells.end(); ++cell)
 	{
-		CellListElem *cell = *node;
 		cell->start_time = timecode;
 		cell->duration = int64_t(cell->frame_dur * cell->nb_frames * 1000000.0);
 		if (cell->found)
 			timecode += cell->duration;
-		++node;
 	}
 }
 // ----------------------------------------------------------------------------
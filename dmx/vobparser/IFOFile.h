@@ -3,21 +3,86 @@
 #define _IFO_FILE_H_
 // ----------------------------------------------------------------------------
 #include <QStringList>
+#include <QMutex>
 
 #include "IFOContent.h"
+#include "DiscCache.h"
 // ----------------------------------------------------------------------------
-class IfoHandleList: public QList<IFOContent*>
+/// how the title set IFOs are loaded, the VMG is always loaded at once
+enum IfoLoadMode
+{
+	IFO_LOAD_EAGER,		///< all the title sets one after the other
+	IFO_LOAD_PARALLEL,	///< all the title sets on a thread pool
+	IFO_LOAD_LAZY		///< each title set on its first access
+};
+// ----------------------------------------------------------------------------
+class IfoHandleList
 {
 public:
-	/// look for IfoContent corresponding to the title
+	IfoHandleList();
+	~IfoHandleList();
+
+	/// load the VMG and the title sets, the VMG must be loaded to get the number of title sets
+	void load(dvd_reader_t *dvd, const QString& filename, IfoLoadMode mode);
+	void clear();
+
+	/// look for IfoContent corresponding to the title, NULL if it could not be loaded
 	IFOContent* getIfoContent(int16_t title) const;
+
+private:
+	friend class IfoLoadTask;
+
+	static IFOContent* loadContent(dvd_reader_t *dvd, int16_t title);
+	void loadParallel(int16_t title);
+
+	// the readers are not thread safe, each parallel load borrows its own one,
+	// all of them are opened on the loading thread
+	void openReader();
+	dvd_reader_t* acquireReader();
+	void releaseReader(dvd_reader_t *dvd);
+
+	dvd_reader_t *m_dvd;
+	QString m_filename;
+	IfoLoadMode m_mode;
+	// files already located by the primary reader, given to the other ones
+	DiscCache::EntryList m_entries;
+
+	// indexed by title number, 0 is the VMG
+	mutable std::vector<IFOContent*> m_contents;
+	mutable std::vector<bool> m_loaded;
+	mutable QMutex m_mutex;
+
+	std::vector<dvd_reader_t*> m_readers;
+	std::vector<dvd_reader_t*> m_freeReaders;
+	QMutex m_readersMutex;
 };
 // ----------------------------------------------------------------------------
+/// Cells of a PGC to process: numbers start at 1, 0 stands for all of them.
+/// The language unit only applies to the menus, the cells are numbered in the PGC.
+typedef struct
+{
+	uint16_t languageUnit;
+	uint16_t pgc;
+	uint16_t firstCell;
+	uint16_t lastCell;
+} PgcSelection;
+
+typedef std::vector<PgcSelection> PgcSelectionList;
+// ----------------------------------------------------------------------------
 class IFOFile  
 {
 public:
-	IFOFile(const QString& filename);
+	/// with a cache directory, the disc layout is kept there between runs
+	IFOFile(const QString& filename, IfoLoadMode mode = IFO_LOAD_LAZY, const QString& cacheDirectory = QString());
 	const CellsListType* GetCellsList(unsigned int title, bool menu);
+	/// set the found flag of the cells without demuxing: the cell must be inside the VOB files,
+	/// start a VOBU of the address map and begin with a navigation pack carrying its IDs.
+	/// Returns the number of cells found.
+	size_t FindCells(unsigned int title, bool menu);
+	/// select the cells played by the given PGCs, an empty list selects all the cells.
+	/// With an angle (from 1), only its cell is kept in the angle blocks of the titles.
+	/// Returns the number of cells selected.
+	size_t SelectCells(unsigned int title, bool menu, const PgcSelectionList& selection, unsigned int angle = 0);
 	virtual ~IFOFile();
 	const pgc_t *FirstPlayPGC() const;
 	const tt_srpt_t *TitleMap() const;
@@ -34,9 +99,22 @@ public:
 	uint8_t GetAudioId(uint8_t streamID, uint8_t title, bool menu) const;
 	IdArray GetSubsId(uint8_t streamID, uint8_t title, bool menu) const;
 
+	/// MD5 based identifier of the disc computed by libdvdread, empty on failure
+	QByteArray DiscID() const;
+	/// MD5 of the raw content of the title IFO file (VIDEO_TS.IFO for title 0)
+	QByteArray InfoFileHash(unsigned int title) const;
+
+	/// give another reader of the same disc the files already located
+	void PrepareReader(dvd_reader_t *dvd) const;
+
 private:
+	void SaveDiscCache();
+
 	IfoHandleList m_ifos;
 	dvd_reader_t* m_dvd;
+	QString m_cacheDirectory;
+	QByteArray m_sourceKey;
+	int m_savedEntries;
 };
 // ----------------------------------------------------------------------------
 #endif
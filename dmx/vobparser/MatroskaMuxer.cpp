@@ -0,0 +1,861 @@
+// ============================================================================
+// MatroskaMuxer class
+// ============================================================================
+
+#include "MatroskaMuxer.h"
+#include "iso/iso_lang.h"
+#include "ebmlwriter.h"
+
+// ----------------------------------------------------------------------------
+
+#define EBML_HEADER				0x1A45DFA3
+#define EBML_VERSION			0x4286
+#define EBML_READ_VERSION		0x42F7
+#define EBML_MAX_ID_LENGTH		0x42F2
+#define EBML_MAX_SIZE_LENGTH	0x42F3
+#define EBML_DOC_TYPE			0x4282
+#define EBML_DOC_TYPE_VERSION	0x4287
+#define EBML_DOC_TYPE_READ		0x4285
+#define EBML_VOID				0xEC
+
+#define MKV_SEGMENT				0x18538067
+#define MKV_SEEK_HEAD			0x114D9B74
+#define MKV_SEEK				0x4DBB
+#define MKV_SEEK_ID				0x53AB
+#define MKV_SEEK_POSITION		0x53AC
+
+#define MKV_INFO				0x1549A966
+#define MKV_TIMECODE_SCALE		0x2AD7B1
+#define MKV_SEGMENT_UID			0x73A4
+#define MKV_MUXING_APP			0x4D80
+#define MKV_WRITING_APP			0x5741
+#define MKV_DURATION			0x4489
+
+#define MKV_TRACKS				0x1654AE6B
+#define MKV_TRACK_ENTRY			0xAE
+#define MKV_TRACK_NUMBER		0xD7
+#define MKV_TRACK_UID			0x73C5
+#define MKV_TRACK_TYPE			0x83
+#define MKV_FLAG_LACING			0x9C
+#define MKV_DEFAULT_DURATION	0x23E383
+#define MKV_NAME				0x536E
+#define MKV_LANGUAGE			0x22B59C
+#define MKV_CODEC_ID			0x86
+#define MKV_CODEC_PRIVATE		0x63A2
+#define MKV_VIDEO				0xE0
+#define MKV_PIXEL_WIDTH			0xB0
+#define MKV_PIXEL_HEIGHT		0xBA
+#define MKV_AUDIO				0xE1
+#define MKV_SAMPLING_FREQUENCY	0xB5
+#define MKV_CHANNELS			0x9F
+#define MKV_BIT_DEPTH			0x6264
+
+#define MKV_CLUSTER				0x1F43B675
+#define MKV_CLUSTER_TIMECODE	0xE7
+#define MKV_SIMPLE_BLOCK		0xA3
+
+#define MKV_CUES				0x1C53BB6B
+#define MKV_CUE_POINT			0xBB
+#define MKV_CUE_TIME			0xB3
+#define MKV_CUE_TRACK_POSITIONS	0xB7
+#define MKV_CUE_TRACK			0xF7
+#define MKV_CUE_CLUSTER_POSITION	0xF1
+
+#define MKV_CHAPTERS			0x1043A770
+
+#define TRACK_TYPE_VIDEO		0x01
+#define TRACK_TYPE_AUDIO		0x02
+#define TRACK_TYPE_SUBTITLE		0x11
+#define TRACK_TYPE_BUTTONS		0x12
+
+// enough bytes to read the header of any audio frame
+#define AUDIO_HEADER_SIZE		10
+
+// ----------------------------------------------------------------------------
+// EBML encoding
+// ----------------------------------------------------------------------------
+
+static void AppendUInt(QByteArray& out, uint32_t id, uint64_t value, int length = 0)
+{
+	QByteArray _data;
+
+	// big endian on the fewest bytes, at least one, unless a length is given
+	do
+	{
+		_data.prepend(char(value & 0xFF));
+		value >>= 8;
+	} while (value || (_data.size() < length));
+
+	EbmlWriter::appendId(out, id);
+	EbmlWriter::appendSize(out, _data.size());
+	out.append(_data);
+}
+
+static void AppendFloat(QByteArray& out, uint32_t id, double value)
+{
+	uint64_t _bits;
+	memcpy(&_bits, &value, sizeof(_bits));
+
+	AppendUInt(out, id, _bits, 8);
+}
+
+static void AppendBinary(QByteArray& out, uint32_t id, const QByteArray& data)
+{
+	EbmlWriter::appendId(out, id);
+	EbmlWriter::appendSize(out, data.size());
+	out.append(data);
+}
+
+// Void element of exactly the given size, at least 2 bytes
+static QByteArray VoidElement(uint64_t size)
+{
+	QByteArray _result;
+	const int _length = (size >= 9) ? 8 : 1;
+
+	EbmlWriter::appendId(_result, EBML_VOID);
+	EbmlWriter::appendSize(_result, size - 1 - _length, _length);
+	_result.append(QByteArray(int(size - 1 - _length), '\0'));
+	return _result;
+}
+
+// ----------------------------------------------------------------------------
+// MatroskaMuxer
+// ----------------------------------------------------------------------------
+
+MatroskaMuxer::MatroskaMuxer(const QString& filename, const QString& application)
+	:m_file(filename)
+	,m_application(application)
+	,m_failed(false)
+	,m_cueTrack(0)
+	,m_segmentStart(0)
+	,m_tracksPosition(0)
+	,m_cuesPosition(0)
+	,m_chaptersPosition(0)
+	,m_infoPosition(0)
+	,m_clusterPosition(0)
+	,m_clusterTime(-1)
+	,m_cellBase(0)
+	,m_cellStart(0)
+	,m_cellDuration(0)
+	,m_firstCell(true)
+	,m_duration(0)
+{
+	for (int i=0; i<256; i++)
+		m_tracks[i] = NULL;
+}
+
+MatroskaMuxer::~MatroskaMuxer()
+{
+	for (size_t i=0; i<m_trackList.size(); i++)
+	{
+		delete m_trackList[i]->parser;
+		delete m_trackList[i];
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+MatroskaMuxer::Track* MatroskaMuxer::AddTrack(uint8_t streamID, TrackKind kind, const QString& codecID, const QString& name, uint16_t language)
+{
+	if (m_tracks[streamID] != NULL)
+		return NULL;
+
+	Track *_track = new Track;
+	_track->kind = kind;
+	_track->number = uint8_t(m_trackList.size() + 1);
+	_track->codecID = codecID;
+	_track->name = name;
+	_track->language = language;
+	_track->width = 0;
+	_track->height = 0;
+	_track->fps = 0.0;
+	_track->sample_rate = 0;
+	_track->channel_nb = 0;
+	_track->position = 0;
+	_track->last_end_timecode = 0;
+	_track->pending_time = 0;
+	_track->parser = NULL;
+
+	m_tracks[streamID] = _track;
+	m_trackList.push_back(_track);
+
+	// blocks of the video, or of the first track without video, start the clusters
+	if (kind == TRACK_VIDEO || m_cueTrack == 0)
+		m_cueTrack = _track->number;
+
+	return _track;
+}
+
+void MatroskaMuxer::AddVideoTrack(uint8_t streamID, uint16_t width, uint16_t height, double fps)
+{
+	Track *_track = AddTrack(streamID, TRACK_VIDEO, "V_MPEG2", "video", 0);
+	if (_track == NULL)
+		return;
+
+	_track->width = width;
+	_track->height = height;
+	_track->fps = fps;
+}
+
+void MatroskaMuxer::AddAudioTrack(uint8_t streamID, TrackKind kind, const QString& name, uint16_t language, uint32_t sample_rate, uint8_t channel_nb)
+{
+	QString _codecID;
+
+	switch (kind)
+	{
+	case TRACK_AC3:
+		_codecID = "A_AC3";
+		break;
+	case TRACK_DTS:
+		_codecID = "A_DTS";
+		break;
+	case TRACK_MPA:
+		_codecID = "A_MPEG/L2";
+		break;
+	case TRACK_LPCM:
+		// the DVD samples are big endian
+		_codecID = "A_PCM/INT/BIG";
+		break;
+	default:
+		return;
+	}
+
+	Track *_track = AddTrack(streamID, kind, _codecID, name, language);
+	if (_track == NULL)
+		return;
+
+	_track->sample_rate = sample_rate;
+	_track->channel_nb = channel_nb;
+}
+
+void MatroskaMuxer::AddSubtitleTrack(uint8_t streamID, const QString& name, uint16_t language, uint16_t width, uint16_t height, const uint32_t * palette)
+{
+	Track *_track = AddTrack(streamID, TRACK_SUBTITLE, "S_VOBSUB", name, language);
+	if (_track == NULL)
+		return;
+
+	_track->width = width;
+	_track->height = height;
+
+	// the settings of the .idx file, without the timestamps
+	QString _private = QString("size: %1x%2\npalette: ").arg(width).arg(height);
+	for (int i=0; i<16; i++)
+		_private += QString(i ? ", %1" : "%1").arg(palette ? palette[i] : 0, 6, 16, QChar('0'));
+	_private += '\n';
+
+	_track->codecPrivate = _private.toLatin1();
+}
+
+void MatroskaMuxer::AddButtonTrack(uint8_t streamID, const QString& name, uint16_t width, uint16_t height)
+{
+	Track *_track = AddTrack(streamID, TRACK_BUTTON, "B_VOBBTN", name, 0);
+	if (_track == NULL)
+		return;
+
+	_track->width = width;
+	_track->height = height;
+}
+
+// ----------------------------------------------------------------------------
+
+void MatroskaMuxer::ProcessStream(uint8_t streamID, uint8_t* buff, uint32_t size, uint32_t start_time, uint32_t end_time)
+{
+	Track *_track = m_tracks[streamID];
+	if (_track == NULL)
+		return;
+
+	if (!m_file.isOpen())
+		WriteHeader();
+
+	// the packets of these streams are timed from the navigation packs, a packet
+	// starting after the end of the previous one leaves a gap like in the .tmc files
+	const int64_t _time = m_cellBase + (int64_t(start_time) - int64_t(m_cellStart)) * 1000000;
+
+	switch (_track->kind)
+	{
+	case TRACK_VIDEO:
+		WriteVideo(*_track, buff, size, false);
+		break;
+
+	case TRACK_AC3:
+	case TRACK_DTS:
+	case TRACK_LPCM:
+		if (start_time > _track->last_end_timecode && _time > _track->position)
+			_track->position = _time;
+		_track->last_end_timecode = end_time;
+		WriteAudio(*_track, buff, size);
+		break;
+
+	case TRACK_MPA:
+		WriteAudio(*_track, buff, size);
+		break;
+
+	case TRACK_SUBTITLE:
+		WriteSubPicture(*_track, buff, size, _time);
+		break;
+
+	case TRACK_BUTTON:
+		WriteBlock(*_track, _time, 0, true, buff, size);
+		break;
+	}
+}
+
+void MatroskaMuxer::SetBoundary(uint32_t start_timecode, uint32_t duration, const CellListElem *cell)
+{
+	if (!m_file.isOpen())
+		WriteHeader();
+
+	// the frames of the previous cell are stamped from its start
+	for (size_t i=0; i<m_trackList.size(); i++)
+	{
+		if (m_trackList[i]->kind == TRACK_VIDEO)
+			WriteVideo(*m_trackList[i], NULL, 0, true);
+	}
+
+	// every track restarts at the IFO end of the previous cell
+	if (!m_firstCell)
+		m_cellBase += int64_t(m_cellDuration) * 1000000;
+	m_firstCell = false;
+
+	m_cellStart = start_timecode;
+	m_cellDuration = duration;
+
+	for (size_t i=0; i<m_trackList.size(); i++)
+	{
+		m_trackList[i]->position = m_cellBase;
+		m_trackList[i]->last_end_timecode = start_timecode;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void MatroskaMuxer::WriteVideo(Track& track, uint8_t* buff, uint32_t size, bool eos)
+{
+	if (track.parser == NULL)
+	{
+		if (eos)
+			return;
+		track.parser = new M2VParser;
+	}
+
+	if (eos)
+		track.parser->SetEOS();
+	else
+		track.parser->WriteData(buff, size);
+
+	while (track.parser->GetState() == MPV_PARSER_STATE_FRAME)
+	{
+		MPEGFrame* _frame = track.parser->ReadFrame();
+		WriteBlock(track, m_cellBase + _frame->timecode, _frame->duration, _frame->frameType == 'I', _frame->data, _frame->size);
+		delete _frame;
+	}
+
+	if (eos)
+	{
+		delete track.parser;
+		track.parser = NULL;
+	}
+}
+
+void MatroskaMuxer::WriteAudio(Track& track, uint8_t* buff, uint32_t size)
+{
+	if (track.kind == TRACK_LPCM)
+	{
+		// no frames, each packet holds whole samples of 16 bits
+		const uint32_t _byteRate = track.sample_rate * track.channel_nb * 2;
+		if (_byteRate == 0)
+			return;
+
+		const int64_t _duration = int64_t(size) * 1000000000 / _byteRate;
+		WriteBlock(track, track.position, _duration, true, buff, size);
+		track.position += _duration;
+		return;
+	}
+
+	track.pending.append((const char*)buff, size);
+
+	int _offset = 0;
+	while (track.pending.size() - _offset >= AUDIO_HEADER_SIZE)
+	{
+		const uint8_t* _data = (const uint8_t*)track.pending.constData() + _offset;
+		const uint32_t _left = track.pending.size() - _offset;
+
+		int64_t _duration = 0;
+		const uint32_t _frameSize = AudioFrameSize(track.kind, _data, _left, track.sample_rate, _duration);
+
+		if (_frameSize == 0)
+		{
+			// not the start of a frame, look for the next sync word
+			_offset++;
+			continue;
+		}
+
+		if (_frameSize > _left)
+			break;
+
+		WriteBlock(track, track.position, _duration, true, _data, _frameSize);
+		track.position += _duration;
+		_offset += _frameSize;
+	}
+
+	track.pending.remove(0, _offset);
+}
+
+void MatroskaMuxer::WriteSubPicture(Track& track, uint8_t* buff, uint32_t size, int64_t time)
+{
+	// the packet is the whole sector, the sub-picture data follows the PES header and the substream ID
+	uint32_t _index = 14 + (buff[13] & 0x07);
+	if (_index + 9 > size || buff[_index] != 0x00 || buff[_index+1] != 0x00 || buff[_index+2] != 0x01 || buff[_index+3] != 0xBD)
+		return;
+
+	const uint32_t _end = _index + 6 + ((buff[_index+4] << 8) | buff[_index+5]);
+	_index += 9 + buff[_index+8] + 1;
+	if (_end > size || _index > _end)
+		return;
+
+	if (track.pending.isEmpty())
+		track.pending_time = time;
+	track.pending.append((const char*)&buff[_index], _end - _index);
+
+	if (track.pending.size() < 2)
+		return;
+
+	const uint8_t* _data = (const uint8_t*)track.pending.constData();
+	const uint32_t _spuSize = (_data[0] << 8) | _data[1];
+
+	if (_spuSize == 0)
+		track.pending.clear();
+	else if (uint32_t(track.pending.size()) >= _spuSize)
+	{
+		WriteBlock(track, track.pending_time, 0, true, _data, _spuSize);
+		track.pending.clear();
+	}
+}
+
+// Size of the audio frame starting with the given bytes and its duration in ns, 0 if there is no frame header
+uint32_t MatroskaMuxer::AudioFrameSize(TrackKind kind, const uint8_t* header, uint32_t size, uint32_t sample_rate, int64_t& duration)
+{
+	if (kind == TRACK_AC3)
+	{
+		// words of 16 bits for 48, 44.1 and 32 kHz
+		static const uint16_t _frameWords[19][3] = {
+			{64, 69, 96}, {80, 87, 120}, {96, 104, 144}, {112, 121, 168}, {128, 139, 192},
+			{160, 174, 240}, {192, 208, 288}, {224, 243, 336}, {256, 278, 384}, {320, 348, 480},
+			{384, 417, 576}, {448, 487, 672}, {512, 557, 768}, {640, 696, 960}, {768, 835, 1152},
+			{896, 975, 1344}, {1024, 1114, 1536}, {1152, 1253, 1728}, {1280, 1393, 1920}};
+		static const uint32_t _rates[3] = {48000, 44100, 32000};
+
+		if (size < 5 || header[0] != 0x0B || header[1] != 0x77)
+			return 0;
+
+		const uint8_t _fscod = header[4] >> 6;
+		const uint8_t _frmsizecod = header[4] & 0x3F;
+		if (_fscod == 3 || _frmsizecod >= 38)
+			return 0;
+
+		uint32_t _words = _frameWords[_frmsizecod >> 1][_fscod];
+		if (_fscod == 1 && (_frmsizecod & 1))
+			_words++;
+
+		duration = int64_t(1536) * 1000000000 / _rates[_fscod];
+		return _words * 2;
+	}
+
+	if (kind == TRACK_DTS)
+	{
+		static const uint32_t _rates[16] = {0, 8000, 16000, 32000, 0, 0, 11025, 22050, 44100, 0, 0, 12000, 24000, 48000, 0, 0};
+
+		if (size < 9 || header[0] != 0x7F || header[1] != 0xFE || header[2] != 0x80 || header[3] != 0x01)
+			return 0;
+
+		const uint32_t _blocks = (((header[4] & 0x01) << 6) | (header[5] >> 2)) + 1;
+		const uint32_t _frameSize = (((header[5] & 0x03) << 12) | (header[6] << 4) | (header[7] >> 4)) + 1;
+		uint32_t _rate = _rates[(header[8] >> 2) & 0x0F];
+		if (_rate == 0)
+			_rate = sample_rate;
+		if (_frameSize < 96 || _rate == 0)
+			return 0;
+
+		duration = int64_t(_blocks * 32) * 1000000000 / _rate;
+		return _frameSize;
+	}
+
+	if (kind == TRACK_MPA)
+	{
+		// kbit/s for MPEG-1 layers I, II, III then MPEG-2 layers I, II and III
+		static const uint16_t _bitrates[5][15] = {
+			{0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+			{0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+			{0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+			{0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+			{0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}};
+		static const uint32_t _rates[3] = {44100, 48000, 32000};
+
+		if (size < 4 || header[0] != 0xFF || (header[1] & 0xE0) != 0xE0)
+			return 0;
+
+		const uint8_t _version = (header[1] >> 3) & 0x03;	// 3 MPEG-1, 2 MPEG-2, 0 MPEG-2.5
+		const uint8_t _layer = 4 - ((header[1] >> 1) & 0x03);
+		const uint8_t _bitrateIndex = header[2] >> 4;
+		const uint8_t _rateIndex = (header[2] >> 2) & 0x03;
+		const uint32_t _padding = (header[2] >> 1) & 0x01;
+		if (_version == 1 || _layer == 4 || _bitrateIndex == 0 || _bitrateIndex == 15 || _rateIndex == 3)
+			return 0;
+
+		const bool _mpeg1 = (_version == 3);
+		const uint32_t _bitrate = 1000 * _bitrates[_mpeg1 ? _layer - 1 : (_layer == 1 ? 3 : 4)][_bitrateIndex];
+		const uint32_t _rate = _rates[_rateIndex] >> (_mpeg1 ? 0 : (_version == 2 ? 1 : 2));
+
+		uint32_t _samples = 1152;
+		uint32_t _frameSize = 144 * _bitrate / _rate + _padding;
+		if (_layer == 1)
+		{
+			_samples = 384;
+			_frameSize = (12 * _bitrate / _rate + _padding) * 4;
+		}
+		else if (_layer == 3 && !_mpeg1)
+		{
+			_samples = 576;
+			_frameSize = 72 * _bitrate / _rate + _padding;
+		}
+
+		duration = int64_t(_samples) * 1000000000 / _rate;
+		return _frameSize;
+	}
+
+	return 0;
+}
+
+// ----------------------------------------------------------------------------
+
+void MatroskaMuxer::WriteBlock(const Track& track, int64_t time, int64_t duration, bool keyframe, const uint8_t* data, uint32_t size)
+{
+	const int64_t _time = time / 1000000;
+	const int64_t _relative = _time - m_clusterTime;
+	const bool _cueBlock = keyframe && (track.number == m_cueTrack);
+
+	// the block timecodes are 16 bits relative to the cluster
+	if (m_clusterTime < 0 || _relative > 32767 || _relative < -32768 || (_cueBlock && _relative >= CLUSTER_DURATION))
+	{
+		CloseCluster();
+
+		m_clusterTime = _time;
+		m_clusterPosition = m_file.pos() - m_segmentStart;
+		AppendUInt(m_cluster, MKV_CLUSTER_TIMECODE, uint64_t(_time));
+	}
+
+	if (_cueBlock && (m_cues.empty() || m_cues.back().cluster_position != m_clusterPosition))
+	{
+		CuePoint _cue;
+		_cue.time = _time;
+		_cue.track = track.number;
+		_cue.cluster_position = m_clusterPosition;
+		m_cues.push_back(_cue);
+	}
+
+	const int16_t _timecode = int16_t(_time - m_clusterTime);
+
+	EbmlWriter::appendId(m_cluster, MKV_SIMPLE_BLOCK);
+	EbmlWriter::appendSize(m_cluster, 4 + size);
+	m_cluster.append(char(0x80 | track.number));
+	m_cluster.append(char((_timecode >> 8) & 0xFF));
+	m_cluster.append(char(_timecode & 0xFF));
+	m_cluster.append(char(keyframe ? 0x80 : 0x00));
+	m_cluster.append((const char*)data, size);
+
+	if (time + duration > m_duration)
+		m_duration = time + duration;
+}
+
+void MatroskaMuxer::CloseCluster()
+{
+	if (m_clusterTime < 0)
+		return;
+
+	QByteArray _header;
+	EbmlWriter::appendId(_header, MKV_CLUSTER);
+	EbmlWriter::appendSize(_header, m_cluster.size());
+
+	Write(_header);
+	Write(m_cluster);
+
+	// keep the allocation for the next cluster
+	m_cluster.resize(0);
+	m_clusterTime = -1;
+}
+
+void MatroskaMuxer::Flush()
+{
+	if (m_file.isOpen())
+		m_file.flush();
+}
+
+// ----------------------------------------------------------------------------
+
+void MatroskaMuxer::WriteHeader()
+{
+	if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		throw VobParserFileOpenException(QFile::encodeName(m_file.fileName()));
+
+	QByteArray _ebml;
+	AppendUInt(_ebml, EBML_VERSION, 1);
+	AppendUInt(_ebml, EBML_READ_VERSION, 1);
+	AppendUInt(_ebml, EBML_MAX_ID_LENGTH, 4);
+	AppendUInt(_ebml, EBML_MAX_SIZE_LENGTH, 8);
+	AppendBinary(_ebml, EBML_DOC_TYPE, "matroska");
+	AppendUInt(_ebml, EBML_DOC_TYPE_VERSION, 2);
+	AppendUInt(_ebml, EBML_DOC_TYPE_READ, 2);
+
+	QByteArray _header;
+	AppendBinary(_header, EBML_HEADER, _ebml);
+
+	// unknown size until Finish, the file stays readable if it is never called
+	EbmlWriter::appendId(_header, MKV_SEGMENT);
+	_header.append(char(0x01));
+	_header.append(QByteArray(7, char(0xFF)));
+	m_segmentStart = _header.size();
+
+	// room for the SeekHead and the Info, known at the end
+	_header.append(VoidElement(RESERVED_SIZE));
+
+	QByteArray _entries;
+	for (size_t i=0; i<m_trackList.size(); i++)
+		_entries.append(TrackEntry(*m_trackList[i]));
+
+	m_tracksPosition = RESERVED_SIZE;
+	AppendBinary(_header, MKV_TRACKS, _entries);
+
+	Write(_header);
+}
+
+QByteArray MatroskaMuxer::TrackEntry(const Track& track) const
+{
+	QByteArray _entry;
+
+	AppendUInt(_entry, MKV_TRACK_NUMBER, track.number);
+	AppendUInt(_entry, MKV_TRACK_UID, track.number);
+	AppendUInt(_entry, MKV_FLAG_LACING, 0);
+
+	if (!track.name.isEmpty())
+		AppendBinary(_entry, MKV_NAME, track.name.toUtf8());
+
+	const char *_language = "und";
+	if (track.language != 0)
+	{
+		const char _code[3] = {char(track.language >> 8), char(track.language & 0xFF), 0};
+		const iso639_lang_t *_lang = GetLang_1(_code);
+		if (_lang->psz_iso639_2B[0] != '?')
+			_language = _lang->psz_iso639_2B;
+	}
+	AppendBinary(_entry, MKV_LANGUAGE, _language);
+
+	AppendBinary(_entry, MKV_CODEC_ID, track.codecID.toLatin1());
+	if (!track.codecPrivate.isEmpty())
+		AppendBinary(_entry, MKV_CODEC_PRIVATE, track.codecPrivate);
+
+	QByteArray _settings;
+
+	switch (track.kind)
+	{
+	case TRACK_VIDEO:
+	case TRACK_BUTTON:
+		AppendUInt(_entry, MKV_TRACK_TYPE, track.kind == TRACK_VIDEO ? TRACK_TYPE_VIDEO : TRACK_TYPE_BUTTONS);
+		if (track.fps > 0.0)
+			AppendUInt(_entry, MKV_DEFAULT_DURATION, uint64_t(1000000000 / track.fps));
+		AppendUInt(_settings, MKV_PIXEL_WIDTH, track.width);
+		AppendUInt(_settings, MKV_PIXEL_HEIGHT, track.height);
+		AppendBinary(_entry, MKV_VIDEO, _settings);
+		break;
+
+	case TRACK_SUBTITLE:
+		AppendUInt(_entry, MKV_TRACK_TYPE, TRACK_TYPE_SUBTITLE);
+		break;
+
+	default:
+		AppendUInt(_entry, MKV_TRACK_TYPE, TRACK_TYPE_AUDIO);
+		AppendFloat(_settings, MKV_SAMPLING_FREQUENCY, track.sample_rate);
+		AppendUInt(_settings, MKV_CHANNELS, track.channel_nb);
+		if (track.kind == TRACK_LPCM)
+			AppendUInt(_settings, MKV_BIT_DEPTH, 16);
+		AppendBinary(_entry, MKV_AUDIO, _settings);
+		break;
+	}
+
+	QByteArray _result;
+	AppendBinary(_result, MKV_TRACK_ENTRY, _entry);
+	return _result;
+}
+
+QByteArray MatroskaMuxer::SeekHead() const
+{
+	struct { uint32_t id; uint64_t position; } _entries[4] = {
+		{MKV_INFO, m_infoPosition},
+		{MKV_TRACKS, m_tracksPosition},
+		{MKV_CUES, m_cuesPosition},
+		{MKV_CHAPTERS, m_chaptersPosition}};
+
+	QByteArray _seeks;
+	for (int i=0; i<4; i++)
+	{
+		// Cues and Chapters are only listed when they are written
+		if (i >= 2 && _entries[i].position == 0)
+			continue;
+
+		QByteArray _id, _seek;
+		EbmlWriter::appendId(_id, _entries[i].id);
+		AppendBinary(_seek, MKV_SEEK_ID, _id);
+		// fixed size, the positions are not known when the SeekHead is measured
+		AppendUInt(_seek, MKV_SEEK_POSITION, _entries[i].position, 8);
+		AppendBinary(_seeks, MKV_SEEK, _seek);
+	}
+
+	QByteArray _result;
+	AppendBinary(_result, MKV_SEEK_HEAD, _seeks);
+	return _result;
+}
+
+QByteArray MatroskaMuxer::Info() const
+{
+	QByteArray _info;
+
+	AppendUInt(_info, MKV_TIMECODE_SCALE, 1000000);
+	if (!m_segmentUID.isEmpty())
+		AppendBinary(_info, MKV_SEGMENT_UID, m_segmentUID);
+	_info.append(m_infoElements);
+	AppendBinary(_info, MKV_MUXING_APP, m_application.toUtf8());
+	AppendBinary(_info, MKV_WRITING_APP, m_application.toUtf8());
+	AppendFloat(_info, MKV_DURATION, m_duration / 1000000.0);
+
+	QByteArray _result;
+	AppendBinary(_result, MKV_INFO, _info);
+	return _result;
+}
+
+QByteArray MatroskaMuxer::Cues() const
+{
+	QByteArray _points;
+
+	for (size_t i=0; i<m_cues.size(); i++)
+	{
+		QByteArray _positions, _point;
+		AppendUInt(_positions, MKV_CUE_TRACK, m_cues[i].track);
+		AppendUInt(_positions, MKV_CUE_CLUSTER_POSITION, m_cues[i].cluster_position);
+
+		AppendUInt(_point, MKV_CUE_TIME, uint64_t(m_cues[i].time));
+		AppendBinary(_point, MKV_CUE_TRACK_POSITIONS, _positions);
+		AppendBinary(_points, MKV_CUE_POINT, _point);
+	}
+
+	QByteArray _result;
+	AppendBinary(_result, MKV_CUES, _points);
+	return _result;
+}
+
+// ----------------------------------------------------------------------------
+
+void MatroskaMuxer::SetChapters(const QByteArray& chapters)
+{
+	m_chapters = chapters;
+}
+
+void MatroskaMuxer::SetSegmentInfo(const QByteArray& segmentUID, const QByteArray& info)
+{
+	m_segmentUID = segmentUID;
+	m_infoElements = ReadElementBody(info, MKV_INFO);
+}
+
+// Content of an element of the given ID found at the start of the data
+QByteArray MatroskaMuxer::ReadElementBody(const QByteArray& element, uint32_t id)
+{
+	QByteArray _id;
+	EbmlWriter::appendId(_id, id);
+
+	if (!element.startsWith(_id) || element.size() <= _id.size())
+		return QByteArray();
+
+	// variable size integer after the ID
+	const uint8_t* _data = (const uint8_t*)element.constData() + _id.size();
+	int _length = 1;
+	while (_length <= 8 && !(_data[0] & (0x100 >> _length)))
+		_length++;
+	if (_length > 8 || _id.size() + _length > element.size())
+		return QByteArray();
+
+	uint64_t _size = _data[0] & (0xFF >> _length);
+	for (int i=1; i<_length; i++)
+		_size = (_size << 8) | _data[i];
+
+	const int _start = _id.size() + _length;
+	if (_size > uint64_t(element.size() - _start))
+		return QByteArray();
+
+	return element.mid(_start, int(_size));
+}
+
+bool MatroskaMuxer::Finish()
+{
+	if (!m_file.isOpen())
+		WriteHeader();
+
+	for (size_t i=0; i<m_trackList.size(); i++)
+	{
+		if (m_trackList[i]->kind == TRACK_VIDEO)
+			WriteVideo(*m_trackList[i], NULL, 0, true);
+	}
+	CloseCluster();
+
+	if (!m_cues.empty())
+	{
+		m_cuesPosition = m_file.pos() - m_segmentStart;
+		Write(Cues());
+	}
+
+	if (!m_chapters.isEmpty())
+	{
+		m_chaptersPosition = m_file.pos() - m_segmentStart;
+		Write(m_chapters);
+	}
+
+	// the Info follows the SeekHead in the reserved space, or goes at the end when it does not fit
+	const QByteArray _info = Info();
+	m_infoPosition = SeekHead().size();
+
+	int _left = RESERVED_SIZE - int(m_infoPosition) - _info.size();
+	if (_left < 2 && _left != 0)
+	{
+		m_infoPosition = m_file.pos() - m_segmentStart;
+		Write(_info);
+		_left = RESERVED_SIZE - SeekHead().size();
+	}
+
+	const uint64_t _segmentSize = m_file.pos() - m_segmentStart;
+
+	QByteArray _reserved = SeekHead();
+	if (m_infoPosition < uint64_t(RESERVED_SIZE))
+		_reserved.append(_info);
+	if (_left > 0)
+		_reserved.append(VoidElement(_left));
+	WriteAt(m_segmentStart, _reserved);
+
+	QByteArray _size;
+	EbmlWriter::appendSize(_size, _segmentSize, 8);
+	WriteAt(m_segmentStart - 8, _size);
+
+	m_file.close();
+
+	return !m_failed && m_file.error() == QFile::NoError;
+}
+
+// ----------------------------------------------------------------------------
+
+void MatroskaMuxer::Write(const QByteArray& data)
+{
+	if (m_file.write(data) != data.size())
+		m_failed = true;
+}
+
+void MatroskaMuxer::WriteAt(uint64_t position, const QByteArray& data)
+{
+	if (!m_file.seek(position) || m_file.write(data) != data.size())
+		m_failed = true;
+}
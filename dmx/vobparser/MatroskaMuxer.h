@@ -0,0 +1,142 @@
+// ============================================================================
+// MatroskaMuxer class
+// ============================================================================
+#ifndef _MATROSKA_MUXER_H_
+#define _MATROSKA_MUXER_H_
+// ----------------------------------------------------------------------------
+#include <stdint.h>
+#include <vector>
+
+#include "VobParser.h"
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+// ============================================================================
+
+// Writes the streams of a demuxing pass straight to a Matroska file, one
+// SimpleBlock per frame. The timeline is the one of the timecode files of the
+// writers: each cell starts where the previous one ended by its IFO duration.
+class MatroskaMuxer
+{
+public:
+	enum TrackKind {TRACK_VIDEO, TRACK_AC3, TRACK_DTS, TRACK_MPA, TRACK_LPCM, TRACK_SUBTITLE, TRACK_BUTTON};
+
+	// the application is written as MuxingApp and WritingApp
+	MatroskaMuxer(const QString& filename, const QString& application);
+	~MatroskaMuxer();
+
+	// The tracks must all be added before the first packet
+	void AddVideoTrack(uint8_t streamID, uint16_t width, uint16_t height, double fps);
+	void AddAudioTrack(uint8_t streamID, TrackKind kind, const QString& name, uint16_t language, uint32_t sample_rate, uint8_t channel_nb);
+	void AddSubtitleTrack(uint8_t streamID, const QString& name, uint16_t language, uint16_t width, uint16_t height, const uint32_t * palette);
+	void AddButtonTrack(uint8_t streamID, const QString& name, uint16_t width, uint16_t height);
+
+	bool HasTrack(uint8_t streamID) const
+	{
+		return m_tracks[streamID] != NULL;
+	}
+
+	void ProcessStream(uint8_t streamID, uint8_t* buff, uint32_t size, uint32_t start_time, uint32_t end_time);
+	void SetBoundary(uint32_t start_timecode, uint32_t duration, const CellListElem *cell);
+
+	// Elements written by ChapterManager in EBML: the Chapters element is copied
+	// as it is, the children of the Info element are added to the file Info
+	void SetChapters(const QByteArray& chapters);
+	void SetSegmentInfo(const QByteArray& segmentUID, const QByteArray& info);
+
+	// Write the last frames, the Cues, the Chapters and the headers
+	bool Finish();
+
+	void Flush();
+
+	QString GetFilename() const
+	{
+		return m_file.fileName();
+	}
+
+	// space kept at the start of the segment for the SeekHead and the Info
+	static const int RESERVED_SIZE = 4096;
+	static const int64_t CLUSTER_DURATION = 2000;
+
+private:
+	struct Track
+	{
+		TrackKind kind;
+		uint8_t number;
+		QString codecID;
+		QString name;
+		uint16_t language;
+		QByteArray codecPrivate;
+		uint16_t width;
+		uint16_t height;
+		double fps;
+		uint32_t sample_rate;
+		uint8_t channel_nb;
+
+		int64_t position;			// time of the next frame in ns
+		uint32_t last_end_timecode;	// end of the last packet in the clock of the VOB
+		QByteArray pending;			// start of a frame or sub-picture split across packets
+		int64_t pending_time;
+		M2VParser *parser;
+	};
+
+	struct CuePoint
+	{
+		int64_t time;
+		uint8_t track;
+		uint64_t cluster_position;
+	};
+
+	Track* AddTrack(uint8_t streamID, TrackKind kind, const QString& codecID, const QString& name, uint16_t language);
+
+	void WriteHeader();
+	void WriteVideo(Track& track, uint8_t* buff, uint32_t size, bool eos);
+	void WriteAudio(Track& track, uint8_t* buff, uint32_t size);
+	void WriteSubPicture(Track& track, uint8_t* buff, uint32_t size, int64_t time);
+	void WriteBlock(const Track& track, int64_t time, int64_t duration, bool keyframe, const uint8_t* data, uint32_t size);
+	void CloseCluster();
+
+	QByteArray TrackEntry(const Track& track) const;
+	QByteArray SeekHead() const;
+	QByteArray Info() const;
+	QByteArray Cues() const;
+
+	static uint32_t AudioFrameSize(TrackKind kind, const uint8_t* header, uint32_t size, uint32_t sample_rate, int64_t& duration);
+	static QByteArray ReadElementBody(const QByteArray& element, uint32_t id);
+
+	void Write(const QByteArray& data);
+	void WriteAt(uint64_t position, const QByteArray& data);
+
+	QFile m_file;
+	QString m_application;
+	bool m_failed;
+	Track* m_tracks[256];
+	std::vector<Track*> m_trackList;
+	uint8_t m_cueTrack;				// video track, or the first one without video
+
+	uint64_t m_segmentStart;		// file position of the segment data
+	uint64_t m_tracksPosition;		// positions relative to the segment data
+	uint64_t m_cuesPosition;
+	uint64_t m_chaptersPosition;
+	uint64_t m_infoPosition;
+
+	uint64_t m_clusterPosition;
+	int64_t m_clusterTime;			// in ms, -1 when no cluster is open
+	QByteArray m_cluster;
+	std::vector<CuePoint> m_cues;
+
+	int64_t m_cellBase;				// start of the current cell in the file in ns
+	uint32_t m_cellStart;			// start of the current cell in the clock of the VOB
+	uint32_t m_cellDuration;
+	bool m_firstCell;
+	int64_t m_duration;
+
+	QByteArray m_chapters;
+	QByteArray m_segmentUID;
+	QByteArray m_infoElements;
+};
+
+// ----------------------------------------------------------------------------
+#endif
+// ----------------------------------------------------------------------------
@@ -3,10 +3,25 @@
 // Copyright  2002 : Christophe PARIS (christophe.paris@free.fr)
 // ============================================================================
 
+#include <algorithm>
 #include <QFileInfo>
+#include <QThread>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#if (defined(WIN32) || defined(WIN64))
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <stdio.h>
+#endif
 
 #include "IFOFile.h"
 #include "VobParser.h"
+#include "MatroskaMuxer.h"
 #include "iso/iso_lang.h"
 
 // ----------------------------------------------------------------------------
@@ -20,6 +35,13 @@
 #define PRIVATE_STREAM2		0xBF
 #define CURRENT_OFFSET		(m_pktindex * DVD_VIDEO_LB_LEN + m_index)
 
+// fields of the PCI packet given to the button writer that change with each
+// VOBU: nv_pck_lbn, then vobu_s_ptm, vobu_e_ptm, vobu_se_e_ptm and e_eltm
+#define PCI_LBN_START		7
+#define PCI_LBN_END			11
+#define PCI_PTM_START		19
+#define PCI_PTM_END			35
+
 #define INDENT_UNIT 2
 unsigned int indent_lvl = 0;
 inline void inc_lvl() { indent_lvl += INDENT_UNIT; }
@@ -36,9 +58,14 @@ void debug (const QString& str)
 // ----------------------------------------------------------------------------
 
 CompositeDemuxWriter::CompositeDemuxWriter()
+	:m_matroska(NULL)
 {
 	for (int i=0; i<256; i++)
+	{
 		m_muxers[i] = NULL;
+		m_packets[i] = 0;
+		m_bytes[i] = 0;
+	}
 }
 
 CompositeDemuxWriter::~CompositeDemuxWriter()
@@ -57,8 +84,32 @@ bool CompositeDemuxWriter::AddDemuxer(uint8_t streamID, Writer * demuxer, QStrin
 
 void CompositeDemuxWriter::ProcessStream(int streamID, uint8_t* buff, uint32_t size, int32_t start_time, int32_t end_time, const QString& debug)
 {
-	if (m_muxers[streamID] != NULL)
+	if (m_matroska != NULL && m_matroska->HasTrack(streamID))
+	{
+		m_packets[streamID]++;
+		m_bytes[streamID] += size;
+		m_matroska->ProcessStream(streamID, buff, size, start_time, end_time);
+	}
+	else if (m_muxers[streamID] != NULL)
+	{
+		m_packets[streamID]++;
+		m_bytes[streamID] += size;
 		m_muxers[streamID]->ProcessStream(buff, size, start_time, end_time, debug);
+	}
+}
+
+void CompositeDemuxWriter::ProcessSector(int streamID, uint8_t* buff, const SectorSource& source, int32_t start_time, int32_t end_time, const QString& debug)
+{
+	if (m_matroska != NULL && m_matroska->HasTrack(streamID))
+	{
+		ProcessStream(streamID, buff, DVD_VIDEO_LB_LEN, start_time, end_time, debug);
+	}
+	else if (m_muxers[streamID] != NULL)
+	{
+		m_packets[streamID]++;
+		m_bytes[streamID] += DVD_VIDEO_LB_LEN;
+		m_muxers[streamID]->ProcessSector(buff, source, start_time, end_time, debug);
+	}
 }
 
 void CompositeDemuxWriter::Reset()
@@ -71,10 +122,14 @@ void CompositeDemuxWriter::Reset()
 			m_muxers[i] = NULL;
 		}
 	}
+	m_matroska = NULL;
 }
 
 void CompositeDemuxWriter::SetBoundary(uint32_t start_timecode, uint32_t duration, const CellListElem *cell)
 {
+	if (m_matroska != NULL)
+		m_matroska->SetBoundary(start_timecode, duration, cell);
+
 	for (int i=0; i<256; i++)
 	{
 		if (m_muxers[i] != NULL)
@@ -84,14 +139,288 @@ void CompositeDemuxWriter::SetBoundary(uint32_t start_timecode, uint32_t duratio
 	}
 }
 
+void CompositeDemuxWriter::Flush()
+{
+	if (m_matroska != NULL)
+		m_matroska->Flush();
+
+	for (int i=0; i<256; i++)
+	{
+		if (m_muxers[i] != NULL)
+			m_muxers[i]->Flush();
+	}
+}
+
+QStringList CompositeDemuxWriter::GetOutputFiles() const
+{
+	QStringList result;
+
+	for (int i=0; i<256; i++)
+	{
+		if (m_muxers[i] != NULL)
+			result += m_muxers[i]->GetOutputFiles();
+	}
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+// Writer state
 // ----------------------------------------------------------------------------
 
-VobParser::VobParser(const char* dirname, int16_t title, bool menu)
+// A file hard linked to an identical output of another pass is given its own
+// copy, so writing it in place leaves the other output alone
+static bool UnlinkSharedFile(const QString& filename)
+{
+#if (defined(WIN32) || defined(WIN64))
+	HANDLE _handle = CreateFileW((LPCWSTR)filename.utf16(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+	if (_handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	BY_HANDLE_FILE_INFORMATION _info;
+	const bool _shared = GetFileInformationByHandle(_handle, &_info) && _info.nNumberOfLinks > 1;
+	CloseHandle(_handle);
+#else
+	struct stat _info;
+	const bool _shared = stat(QFile::encodeName(filename), &_info) == 0 && _info.st_nlink > 1;
+#endif
+
+	if (!_shared)
+		return true;
+
+	const QString _copy = filename + ".copy";
+	QFile::remove(_copy);
+
+	if (!QFile::copy(filename, _copy))
+		return false;
+
+#if (defined(WIN32) || defined(WIN64))
+	const bool _replaced = MoveFileExW((LPCWSTR)_copy.utf16(), (LPCWSTR)filename.utf16(), MOVEFILE_REPLACE_EXISTING);
+#else
+	const bool _replaced = (rename(QFile::encodeName(_copy), QFile::encodeName(filename)) == 0);
+#endif
+
+	if (!_replaced)
+		QFile::remove(_copy);
+
+	return _replaced;
+}
+
+// Reopen an output file left by an interrupted run, dropping what was written after the checkpoint
+static FILE* ReopenOutputFile(const QString& filename, int64_t size, const char* mode)
+{
+	QFile file(filename);
+
+	if (size < 0)
+	{
+		// the file did not exist at checkpoint time, it will be created again when needed
+		file.remove();
+		return NULL;
+	}
+
+	if (!file.exists() || file.size() < size || !UnlinkSharedFile(filename) || !file.resize(size))
+		throw VobParserFileOpenException(QFile::encodeName(filename));
+
+	FILE* result = fopen(QFile::encodeName(filename), mode);
+	if (!result)
+		throw VobParserFileOpenException(QFile::encodeName(filename));
+
+	fseek(result, 0, SEEK_END);
+	return result;
+}
+
+void Writer::SaveState(WriterState& state)
+{
+	Flush();
+
+	memset(&state, 0, sizeof(state));
+	state.file_size = m_file ? ftell(m_file) : -1;
+	state.timecode_file_size = m_TimecodeFile ? ftell(m_TimecodeFile) : -1;
+}
+
+bool Writer::RestoreState(const WriterState& state)
+{
+	if (m_file || m_TimecodeFile)
+		return false;
+
+	try
+	{
+		m_file = ReopenOutputFile(GetOutputFilename(), state.file_size, "r+b");
+		m_TimecodeFile = ReopenOutputFile(GetTimecodeFilename(), state.timecode_file_size, "r+");
+	}
+	catch (VobParserException&)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+void VideoDemuxWriter::SaveState(WriterState& state)
+{
+	Writer::SaveState(state);
+	state.start_timecode = m_start_timecode;
+	state.end_timecode = m_end_timecode;
+	state.last_start_timecode = m_last_start_timecode;
+	state.last_end_timecode = m_last_end_timecode;
+	state.is_still = m_is_still;
+}
+
+bool VideoDemuxWriter::RestoreState(const WriterState& state)
+{
+	if (!Writer::RestoreState(state))
+		return false;
+
+	// the checkpoint is taken on a cell boundary, the frame parser starts empty
+	delete m_parser;
+	m_parser = new M2VParser();
+
+	m_start_timecode = state.start_timecode;
+	m_end_timecode = state.end_timecode;
+	m_last_start_timecode = state.last_start_timecode;
+	m_last_end_timecode = state.last_end_timecode;
+	m_is_still = state.is_still;
+	return true;
+}
+
+void AC3DemuxWriter::SaveState(WriterState& state)
+{
+	Writer::SaveState(state);
+	state.start_timecode = m_start_timecode;
+	state.end_timecode = m_end_timecode;
+	state.last_start_timecode = m_last_start_timecode;
+	state.last_end_timecode = m_last_end_timecode;
+}
+
+bool AC3DemuxWriter::RestoreState(const WriterState& state)
+{
+	if (!Writer::RestoreState(state))
+		return false;
+
+	m_start_timecode = state.start_timecode;
+	m_end_timecode = state.end_timecode;
+	m_last_start_timecode = state.last_start_timecode;
+	m_last_end_timecode = state.last_end_timecode;
+	return true;
+}
+
+void DTSDemuxWriter::SaveState(WriterState& state)
+{
+	Writer::SaveState(state);
+	state.start_timecode = m_start_timecode;
+	state.end_timecode = m_end_timecode;
+	state.last_start_timecode = m_last_start_timecode;
+	state.last_end_timecode = m_last_end_timecode;
+}
+
+bool DTSDemuxWriter::RestoreState(const WriterState& state)
+{
+	if (!Writer::RestoreState(state))
+		return false;
+
+	m_start_timecode = state.start_timecode;
+	m_end_timecode = state.end_timecode;
+	m_last_start_timecode = state.last_start_timecode;
+	m_last_end_timecode = state.last_end_timecode;
+	return true;
+}
+
+void WavWriter::SaveState(WriterState& state)
+{
+	Writer::SaveState(state);
+	if (m_file)
+	{
+		state.riff_size_position = m_size_position1;
+		state.data_size_position = m_size_position2;
+		state.data_size = m_size;
+	}
+}
+
+bool WavWriter::RestoreState(const WriterState& state)
+{
+	if (!Writer::RestoreState(state))
+		return false;
+
+	m_size_position1 = state.riff_size_position;
+	m_size_position2 = state.data_size_position;
+	m_size = state.data_size;
+	return true;
+}
+
+void LPCMDemuxWriter::SaveState(WriterState& state)
+{
+	WavWriter::SaveState(state);
+	state.start_timecode = m_start_timecode;
+	state.end_timecode = m_end_timecode;
+	state.last_start_timecode = m_last_start_timecode;
+	state.last_end_timecode = m_last_end_timecode;
+}
+
+bool LPCMDemuxWriter::RestoreState(const WriterState& state)
+{
+	if (!WavWriter::RestoreState(state))
+		return false;
+
+	m_start_timecode = state.start_timecode;
+	m_end_timecode = state.end_timecode;
+	m_last_start_timecode = state.last_start_timecode;
+	m_last_end_timecode = state.last_end_timecode;
+	return true;
+}
+
+void SubDemuxWriter::SaveState(WriterState& state)
+{
+	Writer::SaveState(state);
+	state.start_timecode = m_start_timecode;
+	state.end_timecode = m_end_timecode;
+}
+
+bool SubDemuxWriter::RestoreState(const WriterState& state)
+{
+	if (!Writer::RestoreState(state))
+		return false;
+
+	m_start_timecode = state.start_timecode;
+	m_end_timecode = state.end_timecode;
+	return true;
+}
+
+void BtnDemuxWriter::SaveState(WriterState& state)
+{
+	Writer::SaveState(state);
+	state.start_timecode = m_start_timecode;
+	state.end_timecode = m_end_timecode;
+	state.last_start_timecode = m_last_start_timecode;
+	state.last_end_timecode = m_last_end_timecode;
+}
+
+bool BtnDemuxWriter::RestoreState(const WriterState& state)
+{
+	if (!Writer::RestoreState(state))
+		return false;
+
+	m_start_timecode = state.start_timecode;
+	m_end_timecode = state.end_timecode;
+	m_last_start_timecode = state.last_start_timecode;
+	m_last_end_timecode = state.last_end_timecode;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+VobParser::VobParser(const char* dirname, int16_t title, bool menu, const IFOFile *ifo)
 	:m_title(title)
 	,m_dvdhandle(NULL)
 	,m_stream(NULL)
 	,m_language(menu)
 	,m_bFirstPacket(true)
+	,m_bCellStart(false)
+	,m_sectorsRead(0)
+	,m_readTime(0)
+	,m_planIndex(0)
+	,m_singleAngle(false)
+	,m_ilvuEnd(0)
+	,m_ilvuNext(0)
+	,m_resync(false)
 {
 	m_pktcount = 0;
 
@@ -102,6 +431,9 @@ VobParser::VobParser(const char* dirname, int16_t title, bool menu)
 
 	if (m_dvdhandle)
 	{
+		if (ifo)
+			ifo->PrepareReader(m_dvdhandle);
+
 		if (m_language)
 			m_stream = DVDOpenFile(m_dvdhandle, title, DVD_READ_MENU_VOBS);
 		else
@@ -124,6 +456,9 @@ VobParser::VobParser(const char* dirname, int16_t title, bool menu)
 
 VobParser::~VobParser()
 {
+	// the writers may still copy sectors from the files of the stream
+	m_demuxer.Flush();
+
 	if (m_stream)
 		DVDCloseFile(m_stream);
 
@@ -140,6 +475,20 @@ uint32_t VobParser::GetPacketCount() const
 
 // ----------------------------------------------------------------------------
 
+uint32_t VobParser::GetPlannedSectors(uint32_t end) const
+{
+	if (m_plan.empty())
+		return std::min(end, m_pktcount);
+
+	uint32_t _count = 0;
+	for (ReadPlan::const_iterator _extent = m_plan.begin(); _extent != m_plan.end() && _extent->first < end; ++_extent)
+		_count += std::min(_extent->last + 1, end) - _extent->first;
+
+	return _count;
+}
+
+// ----------------------------------------------------------------------------
+
 uint32_t VobParser::GetPacketIndex() const
 {
 	return m_pktindex;
@@ -154,26 +503,61 @@ char* VobParser::GetCurrentPacketData() const
 
 // ----------------------------------------------------------------------------
 
+// Move to the next sector to read, false after the last extent of the plan
+bool VobParser::GoToPlannedSector()
+{
+	// jump over the interleaved units of the other angles
+	if (m_ilvuNext && m_pktindex > m_ilvuEnd)
+	{
+		m_pktindex = std::max(m_pktindex, m_ilvuNext);
+		m_ilvuNext = 0;
+	}
+
+	// jump over the sectors between the extents of the plan
+	if (!m_plan.empty())
+	{
+		while (m_planIndex < m_plan.size() && m_plan[m_planIndex].last < m_pktindex)
+			m_planIndex++;
+
+		if (m_planIndex == m_plan.size())
+			return false;
+
+		if (m_pktindex < m_plan[m_planIndex].first)
+			m_pktindex = m_plan[m_planIndex].first;
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// Last sector the current one may be resynchronised to: the end of the current
+// extent of the plan and of the interleaved unit before a pending jump
+uint32_t VobParser::GetResyncLimit() const
+{
+	uint32_t _limit = m_pktcount - 1;
+
+	if (m_planIndex < m_plan.size())
+		_limit = std::min(_limit, m_plan[m_planIndex].last);
+
+	if (m_ilvuNext)
+		_limit = std::min(_limit, m_ilvuEnd);
+
+	return _limit;
+}
+
+// ----------------------------------------------------------------------------
+
 bool VobParser::ParseNextPacket(const CellsListType & Cells)
 {
-	if(GetNextPacket())
-	{	
-		pktinfo.identifier = GetNext32Bits();
-		if((pktinfo.identifier & VOB_SLICE) != VOB_SLICE || (pktinfo.identifier & PACK_HEADER) != PACK_HEADER)
-		{
-			// Invalid block start code
-			throw VobParserInvalidPacketException(CURRENT_OFFSET-4);
-		}
-		
-		ParseSCR(); // System Clock Reference
+	m_bCellStart = false;
 
-		// Program Mux Rate (measured in units of 50 bytes/second)
-		pktinfo.program_mux_rate = (GetNext8Bits() << 14) | 
-			(GetNext8Bits() << 6) | (GetNext8Bits() >> 2);
+	if (!GoToPlannedSector())
+		return false;
 
-		// Skip Pack stuffing length
-		int stuffing_nb = GetNext8Bits() & 0x07;
-		SkipNBytes(stuffing_nb);
+	if(GetNextPack())
+	{	
+		ParsePackHeader();
 		
 		uint32_t _Header = GetNext32Bits();
 		int _StreamID;
@@ -182,37 +566,17 @@ bool VobParser::ParseNextPacket(const CellsListType & Cells)
 			_StreamID = _Header & 0xFF;
 			if (_StreamID == SYSTEM_HEADER)
 			{
-				// skip the system header data
-				uint16_t _size = GetNext16Bits();
-				SkipNBytes(_size);
+				ParseSystemHeader();
+				UpdateInterleavedUnit();
 
-				while (AvailablePacketData())
-				{
-					_Header = GetNext32Bits();
-					uint8_t _StreamId = _Header & 0xFF;
-					if (_StreamId == PRIVATE_STREAM2)
-					{
-						debug("Navigation pack {\n");
-						inc_lvl();
-						debug(QString("SCR: %1.%2\n").arg(pktinfo.scr).arg(pktinfo.scr_ext));
-						debug(QString("Program mux rate: %1 (%2 bps)\n").arg(pktinfo.program_mux_rate).arg(pktinfo.program_mux_rate * 50 * 8));
-						ParseNavPacket();
-						dec_lvl();
-						debug("}\n");
-					}
-					else
-					{
-						// skip these data
-						uint16_t _size = GetNext16Bits();
-						SkipNBytes(_size);
-					}
-				}
 				if (IsNewCell()) {
 					CellListElem* cell = Cells.at(GetVobID(), GetCellID());
 
-					if (cell != NULL)
+					// the cells left out of the selection may share sectors with the others
+					if (cell != NULL && cell->selected)
 					{
 						cell->found = true;
+						m_bCellStart = true;
 						if (m_dsi.nv_pck_scr == 0)
 							m_pci_vob_timecode_offset = m_pci.vobu_s_ptm / 90;
 						m_demuxer.SetBoundary(m_pci.vobu_s_ptm/90 - m_pci_vob_timecode_offset, cell->nb_frames * cell->frame_dur, cell);
@@ -279,6 +643,117 @@ bool VobParser::ParseNextPacket(const CellsListType & Cells)
 
 // ----------------------------------------------------------------------------
 
+// Restart parsing right after the navigation pack found at the given sector,
+// as if all the previous packets had just been parsed
+bool VobParser::Resume(uint32_t sector, uint32_t timecodeOffset)
+{
+	Reset();
+
+	m_pktindex = sector;
+	if (!GetNextPacket())
+		return false;
+
+	ParsePackHeader();
+
+	uint32_t _Header = GetNext32Bits();
+	if ((_Header & VOB_SLICE) != VOB_SLICE || (_Header & 0xFF) != SYSTEM_HEADER)
+		return false;
+
+	ParseSystemHeader();
+	IsNewCell();
+	UpdateInterleavedUnit();
+
+	m_pci_vob_timecode_offset = timecodeOffset;
+	m_pktindex++;
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+int64_t VobParser::ParseNextVOBU()
+{
+	while (m_pktindex < m_pktcount)
+	{
+		if (!GetNextPacket())
+			return -1;
+
+		ParsePackHeader();
+
+		uint32_t _Header = GetNext32Bits();
+		if ((_Header & VOB_SLICE) == VOB_SLICE && (_Header & 0xFF) == SYSTEM_HEADER)
+		{
+			ParseSystemHeader();
+			IsNewCell();
+
+			uint32_t _sector = m_pktindex;
+			m_pktindex += m_dsi.vobu_ea + 1;
+			return _sector;
+		}
+
+		// a wrong end address lands inside a VOBU, look for the next navigation pack
+		debug(QString("ParseNextVOBU: no navigation pack @LBA=%1\n").arg(m_pktindex));
+		m_pktindex++;
+	}
+
+	return -1;
+}
+
+// ----------------------------------------------------------------------------
+
+void VobParser::ParsePackHeader()
+{
+	pktinfo.identifier = GetNext32Bits();
+	if((pktinfo.identifier & VOB_SLICE) != VOB_SLICE || (pktinfo.identifier & PACK_HEADER) != PACK_HEADER)
+	{
+		// Invalid block start code
+		throw VobParserInvalidPacketException(CURRENT_OFFSET-4);
+	}
+	
+	ParseSCR(); // System Clock Reference
+
+	// Program Mux Rate (measured in units of 50 bytes/second)
+	pktinfo.program_mux_rate = (GetNext8Bits() << 14) | 
+		(GetNext8Bits() << 6) | (GetNext8Bits() >> 2);
+
+	// Skip Pack stuffing length
+	int stuffing_nb = GetNext8Bits() & 0x07;
+	SkipNBytes(stuffing_nb);
+}
+
+// ----------------------------------------------------------------------------
+
+void VobParser::ParseSystemHeader()
+{
+	// skip the system header data
+	uint16_t _size = GetNext16Bits();
+	SkipNBytes(_size);
+
+	while (AvailablePacketData())
+	{
+		uint32_t _Header = GetNext32Bits();
+		uint8_t _StreamId = _Header & 0xFF;
+		if (_StreamId == PRIVATE_STREAM2)
+		{
+			debug("Navigation pack {\n");
+			inc_lvl();
+			debug(QString("SCR: %1.%2\n").arg(pktinfo.scr).arg(pktinfo.scr_ext));
+			debug(QString("Program mux rate: %1 (%2 bps)\n").arg(pktinfo.program_mux_rate).arg(pktinfo.program_mux_rate * 50 * 8));
+			ParseNavPacket();
+			dec_lvl();
+			debug("}\n");
+		}
+		else
+		{
+			// skip these data
+			uint16_t _size = GetNext16Bits();
+			SkipNBytes(_size);
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
 bool VobParser::AvailablePacketData() const
 {
 	return (m_index < DVD_VIDEO_LB_LEN);
@@ -290,7 +765,137 @@ bool VobParser::GetNextPacket()
 {
 	m_index = 0;
 
-	return (DVDReadBlocks(m_stream, m_pktindex, 1, m_buff) == 1);
+	m_readTimer.start();
+	bool result = (DVDReadBlocks(m_stream, m_pktindex, 1, m_buff) == 1);
+	m_readTime += m_readTimer.nsecsElapsed();
+
+	if (result)
+		m_sectorsRead++;
+
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+
+static inline bool IsPackStart(const uint8_t * sector)
+{
+	return sector[0] == 0x00 && sector[1] == 0x00 && sector[2] == 0x01 && sector[3] == 0xBA;
+}
+
+// ----------------------------------------------------------------------------
+
+// Read the sector to parse. In resync mode, a damaged one is skipped with the
+// following ones up to the next sector starting with a pack header, in the same
+// extent of the plan and the same interleaved unit, or up to the next extent.
+bool VobParser::GetNextPack()
+{
+	if (!m_resync)
+		return GetNextPacket();
+
+	while (m_pktindex < m_pktcount)
+	{
+		if (ReadSectorWithRetries() && IsPackStart(m_buff))
+			return true;
+
+		const uint32_t _first = m_pktindex;
+		m_pktindex = FindNextPackStart(m_pktindex + 1, GetResyncLimit());
+		AddSkippedSectors(_first, m_pktindex - 1);
+
+		fprintf(stderr, "Skipped damaged sectors %u to %u\n", _first, m_pktindex - 1);
+
+		if (!GoToPlannedSector())
+			return false;
+	}
+
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+
+// The read errors of aging discs are often transient, wait a little longer
+// before each new attempt
+bool VobParser::ReadSectorWithRetries()
+{
+	for (int _attempt = 0; ; _attempt++)
+	{
+		if (GetNextPacket())
+			return true;
+
+		if (_attempt == READ_RETRIES)
+			return false;
+
+		QThread::msleep(RETRY_DELAY << _attempt);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// A pack starts at a sector boundary, only the first bytes of each sector are
+// checked. The sectors are read by batch, and one by one without retry in a
+// batch that cannot be read. Returns the sector after the limit if none is found.
+uint32_t VobParser::FindNextPackStart(uint32_t sector, uint32_t limit)
+{
+	std::vector<uint8_t> _batch(RESYNC_BATCH * DVD_VIDEO_LB_LEN);
+
+	while (sector <= limit)
+	{
+		const uint32_t _count = std::min<uint32_t>(RESYNC_BATCH, limit - sector + 1);
+
+		m_readTimer.start();
+		const bool _read = (DVDReadBlocks(m_stream, sector, _count, &_batch[0]) == ssize_t(_count));
+		m_readTime += m_readTimer.nsecsElapsed();
+
+		if (_read)
+			m_sectorsRead += _count;
+
+		for (uint32_t i = 0; i < _count; i++)
+		{
+			if (!_read)
+			{
+				m_readTimer.start();
+				const bool _sectorRead = (DVDReadBlocks(m_stream, sector + i, 1, &_batch[i * DVD_VIDEO_LB_LEN]) == 1);
+				m_readTime += m_readTimer.nsecsElapsed();
+
+				if (!_sectorRead)
+					continue;
+
+				m_sectorsRead++;
+			}
+
+			if (IsPackStart(&_batch[i * DVD_VIDEO_LB_LEN]))
+				return sector + i;
+		}
+
+		sector += _count;
+	}
+
+	return limit + 1;
+}
+
+// ----------------------------------------------------------------------------
+
+void VobParser::AddSkippedSectors(uint32_t first, uint32_t last)
+{
+	if (!m_skipped.empty() && m_skipped.back().last + 1 >= first)
+	{
+		m_skipped.back().last = std::max(m_skipped.back().last, last);
+		return;
+	}
+
+	SectorExtent _range;
+	_range.first = first;
+	_range.last = last;
+	m_skipped.push_back(_range);
+}
+
+// ----------------------------------------------------------------------------
+
+SectorSource VobParser::GetSectorSource() const
+{
+	SectorSource _source;
+	if (DVDFileBlockSource(m_stream, m_pktindex, &_source.fd, &_source.position) <= 0)
+		_source.fd = -1;
+	return _source;
 }
 
 // ----------------------------------------------------------------------------
@@ -528,6 +1133,11 @@ void VobParser::ParseDSI()
 	m_dsi.vobu_c_idn = GetNext8Bits();
 	m_dsi.c_eltm = GetNext32Bits();
 
+	// Seamless Playback Information
+	m_dsi.sml_category = GetNext16Bits();
+	m_dsi.ilvu_ea = GetNext32Bits();
+	m_dsi.ilvu_sa = GetNext32Bits();
+
 	debug(QString("nv_pck_scr: %1\n").arg(m_dsi.nv_pck_scr));
 	debug(QString("nv_pck_lbn: %1\n").arg(m_dsi.nv_pck_lbn));
 	debug(QString("vobu_ea: %1\n").arg(m_dsi.vobu_ea));
@@ -538,6 +1148,27 @@ void VobParser::ParseDSI()
 	debug(QString("reserved: %1\n").arg(m_dsi.reserved));
 	debug(QString("vobu_c_idn: %1\n").arg(m_dsi.vobu_c_idn));
 	debug(QString("c_eltm: %1\n").arg(m_dsi.c_eltm));
+	debug(QString("sml_category: %1\n").arg(m_dsi.sml_category, 0, 16));
+	debug(QString("ilvu_ea: %1\n").arg(m_dsi.ilvu_ea));
+	debug(QString("ilvu_sa: %1\n").arg(m_dsi.ilvu_sa));
+}
+
+// ----------------------------------------------------------------------------
+
+// At the navigation pack of the last VOBU of an interleaved unit, remember where
+// the unit ends and where the next one of the same angle starts. The units of the
+// other angles in between are not read.
+void VobParser::UpdateInterleavedUnit()
+{
+	if (!m_singleAngle || (m_dsi.sml_category & (DSI_ILVU_BLOCK | DSI_ILVU_LAST)) != (DSI_ILVU_BLOCK | DSI_ILVU_LAST))
+		return;
+
+	// the last unit of the block has no next one
+	if (m_dsi.ilvu_sa == 0 || m_dsi.ilvu_sa == 0xFFFFFFFF)
+		return;
+
+	m_ilvuEnd = m_pktindex + m_dsi.ilvu_ea;
+	m_ilvuNext = m_pktindex + m_dsi.ilvu_sa;
 }
 
 // ----------------------------------------------------------------------------
@@ -668,7 +1299,7 @@ void VobParser::ParsePrivateStream1()
 		debug(QString("Subtitles streamID = 0x%1\n").arg(substreamID, 0, 16));
 
 		// .sub files the VobSub way (includes the whole packet)
-		m_demuxer.ProcessStream(substreamID, m_buff, DVD_VIDEO_LB_LEN, t3, t4, 
+		m_demuxer.ProcessSector(substreamID, m_buff, GetSectorSource(), t3, t4, 
 		    QString("DTS %1 PTS %2 - %3 %4\n").arg(m_startdts/90).arg(m_startpts/90).arg(pktinfo.dts/90).arg(pktinfo.pts/90));
 	}
 	else if(substreamID >= SUBSTREAM_AC3_LOW && substreamID < SUBSTREAM_AC3_HIGH)
@@ -725,6 +1356,10 @@ void VobParser::Reset()
 	previous_cellid = -1;
 	m_index = 0;
 	m_pktindex = 0;
+	m_planIndex = 0;
+	m_ilvuEnd = 0;
+	m_ilvuNext = 0;
+	m_skipped.clear();
 	DVDFileSeek(m_stream,0);
 }
 
@@ -743,19 +1378,6 @@ bool VobParser::IsNewCell()
 	return result;
 }
 
-// ----------------------------------------------------------------------------
-
-inline uint8_t VobParser::GetVobID() const
-{
-	return m_dsi.vobu_vob_idn;
-}
-
-// ----------------------------------------------------------------------------
-
-inline uint8_t VobParser::GetCellID() const
-{
-	return m_dsi.vobu_c_idn;
-}
 
 // ----------------------------------------------------------------------------
 
@@ -774,6 +1396,7 @@ void SubDemuxWriter::WriteTimecodeInfo(uint32_t start_time, uint32_t end_time, u
 	{
 		QString m_filename (m_Filename);
 		m_filename += ".idx";
+		QFile::remove(m_filename);
 		m_TimecodeFile = fopen(QFile::encodeName(m_filename),"w");
 
 		fwrite("# VobSub index file, v7 (do not modify this line!)\n#\n", 1, 53, m_TimecodeFile);
@@ -1071,6 +1694,92 @@ void MPADemuxWriter::SetBoundary(uint32_t start_timecode, uint32_t duration, con
 {
 }
 
+void SubDemuxWriter::ProcessSector(uint8_t* buff, const SectorSource& source, uint32_t start_time, uint32_t end_time, const QString& debug)
+{
+#ifdef __linux__
+	if (source.fd >= 0 && !m_copyFailed)
+	{
+		if (m_runLength > 0 && (source.fd != m_runFd || source.position != m_runPosition + m_runLength))
+			FlushRun();
+
+		// the index points after the sectors not copied yet
+		m_file = OpenOuputFile();
+		WriteTimecodeInfo(start_time, end_time, ftello(m_file) + m_runLength, debug);
+
+		if (m_runLength == 0)
+		{
+			m_runFd = source.fd;
+			m_runPosition = source.position;
+		}
+		m_runLength += DVD_VIDEO_LB_LEN;
+		return;
+	}
+#endif
+	ProcessStream(buff, DVD_VIDEO_LB_LEN, start_time, end_time, debug);
+}
+
+void SubDemuxWriter::FlushRun()
+{
+	if (m_runLength == 0)
+		return;
+
+	int64_t _position = m_runPosition;
+	int64_t _length = m_runLength;
+	m_runLength = 0;
+
+	if (!m_copyFailed && CopyRun(_position, _length))
+		return;
+
+#ifdef __linux__
+	// buffered writes of what could not be copied
+	uint8_t _buff[DVD_VIDEO_LB_LEN];
+	while (_length > 0)
+	{
+		ssize_t _size = _length < DVD_VIDEO_LB_LEN ? _length : DVD_VIDEO_LB_LEN;
+		if (pread(m_runFd, _buff, _size, _position) != _size)
+		{
+			qWarning("Could not read the subtitle sectors at %lld of the source.", (long long)_position);
+			return;
+		}
+		fwrite(_buff, 1, _size, m_file);
+		_position += _size;
+		_length -= _size;
+	}
+#endif
+}
+
+// Copies what it can of the run, position and length are left on the remaining bytes
+bool SubDemuxWriter::CopyRun(int64_t& position, int64_t& length)
+{
+#ifdef __linux__
+	fflush(m_file);
+	off64_t _in = position;
+	off64_t _out = ftello(m_file);
+
+	while (length > 0)
+	{
+		ssize_t _copied = copy_file_range(m_runFd, &_in, fileno(m_file), &_out, length, 0);
+		if (_copied <= 0)
+		{
+			// different file systems on older kernels, or no support at all
+			if (_copied < 0 && errno != EINTR)
+				m_copyFailed = true;
+			if (m_copyFailed || _copied == 0)
+				break;
+			continue;
+		}
+		position += _copied;
+		length -= _copied;
+	}
+
+	// the stream position follows the copied bytes
+	fseeko(m_file, _out, SEEK_SET);
+	return length == 0;
+#else
+	return false;
+#endif
+}
+
 void SubDemuxWriter::SetBoundary(uint32_t start_timecode, uint32_t duration, const CellListElem *cell)
 {
 	if (start_timecode == 0)
@@ -1078,10 +1787,33 @@ void SubDemuxWriter::SetBoundary(uint32_t start_timecode, uint32_t duration, con
 	m_end_timecode += duration;
 }
 
+bool BtnDemuxWriter::IsRepeatedPCI(const uint8_t* buff, uint32_t size, uint32_t start_time)
+{
+	// only a block that follows the previous one without a gap can extend it
+	bool _repeated = (start_time == m_last_end_timecode && size > PCI_PTM_END
+		&& (uint32_t)m_last_pci.size() == size);
+
+	if (_repeated)
+	{
+		const uint8_t* _last = (const uint8_t*)m_last_pci.constData();
+		_repeated = memcmp(buff, _last, PCI_LBN_START) == 0
+			&& memcmp(buff + PCI_LBN_END, _last + PCI_LBN_END, PCI_PTM_START - PCI_LBN_END) == 0
+			&& memcmp(buff + PCI_PTM_END, _last + PCI_PTM_END, size - PCI_PTM_END) == 0;
+	}
+
+	if (!_repeated)
+		m_last_pci = QByteArray((const char*)buff, size);
+
+	return _repeated;
+}
+
 void BtnDemuxWriter::SetBoundary(uint32_t start_timecode, uint32_t duration, const CellListElem *cell)
 {
 	m_TimecodeFile = GetTimecodeFile();
 
+	// each cell starts with a block of its own
+	m_last_pci.clear();
+
 	// handle ending of the previous cell
 	if (m_last_end_timecode < m_end_timecode)
 	{
@@ -10,6 +10,7 @@
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdexcept>
+#include <vector>
 
 #include "dvdread/ifo_read.h"
 #include "mpegparser/M2VParser.h"
@@ -17,6 +18,9 @@
 #include <QList>
 #include <QFile>
 #include <QString>
+#include <QByteArray>
+#include <QStringList>
+#include <QElapsedTimer>
 // ============================================================================
 
 #define VIDEO_STREAM_TYPE		0x01
@@ -34,6 +38,10 @@
 #define SUBSTREAM_PCI       0x00
 #define SUBSTREAM_DSI       0x01
 
+// interleaved unit flags of the DSI seamless playback category (high nibble)
+#define DSI_ILVU_BLOCK      0x4000
+#define DSI_ILVU_LAST       0x1000
+
 #define SUBSTREAM_SUB_LOW		0x20
 #define SUBSTREAM_SUB_HIGH		(SUBSTREAM_SUB_LOW + 32)
 
@@ -68,6 +76,16 @@ typedef struct
 	//ButtonsListType btt_list;
 } CellListElem;
 
+// Sectors of the VOB files to read, both ends included
+typedef struct
+{
+	uint32_t first;
+	uint32_t last;
+} SectorExtent;
+
+// Extents sorted by sector, not overlapping nor adjacent
+typedef std::vector<SectorExtent> ReadPlan;
+
 typedef struct {
 	uint16_t start_x;				// Starting X position
 	uint16_t start_y;				// Starting Y position
@@ -119,6 +137,9 @@ typedef struct {
 	uint8_t  reserved		: 8;	// Reserved
 	uint8_t  vobu_c_idn		: 8;	// CELL number within VOB
 	uint32_t c_eltm			: 32;	// Cell elapsed time (BCD)
+	uint16_t sml_category	: 16;	// Seamless playback category, interleaved unit flags in the high nibble
+	uint32_t ilvu_ea		: 32;	// Interleaved unit end address - relative offset to its last sector
+	uint32_t ilvu_sa		: 32;	// Next interleaved unit of the same angle - relative offset to its first sector
 } nav_dsi_gi;
 
 typedef struct {
@@ -185,10 +206,37 @@ public:
 	}
 };
 
+// ----------------------------------------------------------------------------
+
+// Snapshot of a writer taken at a cell boundary, used to resume an interrupted extraction
+typedef struct
+{
+	int64_t file_size;				// size of the output file, -1 if it was not created yet
+	int64_t timecode_file_size;		// size of the timecode file, -1 if it was not created yet
+	uint32_t start_timecode;
+	uint32_t end_timecode;
+	uint32_t last_start_timecode;
+	uint32_t last_end_timecode;
+	bool is_still;
+	uint64_t riff_size_position;	// WAV header fields
+	uint64_t data_size_position;
+	uint64_t data_size;
+} WriterState;
+
 // ============================================================================
 // Demuxer class
 // ============================================================================
 
+// Location of the sector being demuxed in the image or VOB file it was read
+// from, fd is -1 when the sector is only available through libdvdread
+typedef struct
+{
+	int fd;
+	int64_t position;
+} SectorSource;
+
+// ----------------------------------------------------------------------------
+
 class Demuxer
 {
 public:
@@ -228,16 +276,62 @@ public:
 		fwrite(buff, 1, size, m_file);
 	}
 
+	// Whole sector of the source, written like any other packet unless the writer can copy it
+	virtual void ProcessSector(uint8_t* buff, const SectorSource& source, uint32_t start_time, uint32_t end_time, const QString& debug)
+	{
+		ProcessStream(buff, DVD_VIDEO_LB_LEN, start_time, end_time, debug);
+	}
+
 	bool FileExists() const {
 		return m_file != NULL;
 	}
 
+	// Push buffered data to the output files so their sizes on disk are accurate
+	virtual void Flush()
+	{
+		if (m_file)
+			fflush(m_file);
+		if (m_TimecodeFile)
+			fflush(m_TimecodeFile);
+	}
+
+	virtual void SaveState(WriterState& state);
+	virtual bool RestoreState(const WriterState& state);
+
+	// Amount of data kept in memory until it can be written
+	virtual uint32_t GetBufferedBytes() const
+	{
+		return 0;
+	}
+
+	// Files created so far by this writer
+	QStringList GetOutputFiles() const
+	{
+		QStringList result;
+		if (m_file)
+			result.append(GetOutputFilename());
+		if (m_TimecodeFile)
+			result.append(GetTimecodeFilename());
+		return result;
+	}
+
 protected:
+	QString GetOutputFilename() const
+	{
+		return QString("%1.%2").arg(m_Filename).arg(m_fileExtension);
+	}
+
+	virtual QString GetTimecodeFilename() const
+	{
+		return QString("%1_%2.tmc").arg(m_Filename).arg(m_fileExtension);
+	}
+
 	inline FILE* GetTimecodeFile()
 	{
 		if (!m_TimecodeFile)
 		{
-			QString m_filename = QString("%1_%2.tmc").arg(m_Filename).arg(m_fileExtension);
+			QString m_filename = GetTimecodeFilename();
+			QFile::remove(m_filename);
 			m_TimecodeFile = fopen(QFile::encodeName(m_filename),"w");
 			
 			if (!m_TimecodeFile)
@@ -253,7 +347,9 @@ protected:
 	{
 		if(!m_file)
 		{
-			QString m_filename = QString("%1.%2").arg(m_Filename).arg(m_fileExtension);
+			QString m_filename = GetOutputFilename();
+			// a previous run may have left a hard link to the file of another menu
+			QFile::remove(m_filename);
 			m_file = fopen(QFile::encodeName(m_filename),"wb");
 
 			if (!m_file)
@@ -286,6 +382,12 @@ public:
 	{}
 	void ProcessStream(uint8_t* buff, uint32_t size, uint32_t start_time, uint32_t end_time, const QString& debug);
 	void SetBoundary(uint32_t start_timecode, uint32_t duration, const CellListElem *cell);
+	void SaveState(WriterState& state);
+	bool RestoreState(const WriterState& state);
+	uint32_t GetBufferedBytes() const
+	{
+		return m_parser ? m_parser->GetBufferLength() : 0;
+	}
 	~VideoDemuxWriter();
 protected:
 	void WriteTimecodeInfo(uint32_t start_time, uint32_t end_time, uint64_t filepos, const QString& debug);
@@ -316,6 +418,8 @@ public:
 		Write(buff,size, start_time, end_time, debug);
 	}
 	void SetBoundary(uint32_t start_timecode, uint32_t duration, const CellListElem *cell);
+	void SaveState(WriterState& state);
+	bool RestoreState(const WriterState& state);
 private:
 	uint8_t m_streamID;
 protected:
@@ -344,6 +448,8 @@ public:
 		Write(buff,size, start_time, end_time, debug);
 	}
 	void SetBoundary(uint32_t start_timecode, uint32_t duration, const CellListElem *cell);
+	void SaveState(WriterState& state);
+	bool RestoreState(const WriterState& state);
 private:
 	uint8_t m_streamID;
 protected:
@@ -367,6 +473,8 @@ class WavWriter : public Writer
 		{}
 		~WavWriter();
 		void Write(uint8_t* buff, uint32_t size, uint32_t start_time, uint32_t end_time, const QString& debug);
+		void SaveState(WriterState& state);
+		bool RestoreState(const WriterState& state);
 	protected:
 		uint32_t m_sample_rate;
 		uint8_t m_bit_depth, m_channel_nb;
@@ -389,6 +497,8 @@ public:
 		Write(buff,size, start_time, end_time, debug);
 	}
 	void SetBoundary(uint32_t start_timecode, uint32_t duration, const CellListElem *cell);
+	void SaveState(WriterState& state);
+	bool RestoreState(const WriterState& state);
 private:
 	uint8_t m_streamID;
 protected:
@@ -431,15 +541,41 @@ public:
 		,m_language(language)
 		,m_start_timecode(0)
 		,m_end_timecode(0)
+		,m_runFd(-1)
+		,m_runPosition(0)
+		,m_runLength(0)
+		,m_copyFailed(false)
 	{}
+	~SubDemuxWriter()
+	{
+		FlushRun();
+	}
 	void ProcessStream(uint8_t* buff, uint32_t size, uint32_t start_time, uint32_t end_time, const QString& debug)
 	{
+		FlushRun();
 		Write(buff,size, start_time, end_time, debug);
 	}
+	void ProcessSector(uint8_t* buff, const SectorSource& source, uint32_t start_time, uint32_t end_time, const QString& debug);
 	void SetBoundary(uint32_t start_timecode, uint32_t duration, const CellListElem *cell);
+	void Flush()
+	{
+		FlushRun();
+		Writer::Flush();
+	}
+	void SaveState(WriterState& state);
+	bool RestoreState(const WriterState& state);
 protected:
 	void WriteTimecodeInfo(uint32_t start_time, uint32_t end_time, uint64_t filepos, const QString& debug);
+	QString GetTimecodeFilename() const
+	{
+		return m_Filename + ".idx";
+	}
 private:
+	// the sectors of the source are gathered in runs of contiguous bytes,
+	// copied to the .sub file by the kernel when the run is broken
+	void FlushRun();
+	bool CopyRun(int64_t& position, int64_t& length);
+
 	uint16_t m_width;
 	uint16_t m_height;
 	bool m_forced;
@@ -447,6 +583,10 @@ private:
 	uint16_t m_language;
 	uint32_t m_start_timecode;
 	uint32_t m_end_timecode;
+	int m_runFd;
+	int64_t m_runPosition;
+	int64_t m_runLength;
+	bool m_copyFailed;				// copy_file_range is not supported between the files
 };
 
 // ----------------------------------------------------------------------------
@@ -481,12 +621,23 @@ public:
 			_tmp[3] = 0;
 			fwrite(_tmp, 4, 1, m_file);
 		}
+		// a static menu repeats the same buttons in every VOBU, the block
+		// already written lasts until they change
+		if (IsRepeatedPCI(buff, size, start_time))
+		{
+			WriteTimecodeInfo(start_time, end_time, ftell(m_file), debug);
+			return;
+		}
 		Write(buff,size, start_time, end_time, debug);
 	}
 	void SetBoundary(uint32_t start_timecode, uint32_t duration, const CellListElem *cell);
+	void SaveState(WriterState& state);
+	bool RestoreState(const WriterState& state);
 	~BtnDemuxWriter();
 protected:
 	void WriteTimecodeInfo(uint32_t start_time, uint32_t end_time, uint64_t filepos, const QString& debug);
+	bool IsRepeatedPCI(const uint8_t* buff, uint32_t size, uint32_t start_time);
+	QByteArray m_last_pci;
 	uint16_t m_width, m_height;
 	uint32_t m_start_timecode;
 	uint32_t m_end_timecode;
@@ -496,6 +647,8 @@ protected:
 
 // ----------------------------------------------------------------------------
 
+class MatroskaMuxer;
+
 class CompositeDemuxWriter
 {
 public:
@@ -503,6 +656,7 @@ public:
 	~CompositeDemuxWriter();
 	bool AddDemuxer(uint8_t streamID, Writer * demuxer, QString& CommandLine);
 	void ProcessStream(int streamID, uint8_t* buff, uint32_t size, int32_t start_time, int32_t end_time, const QString& debug);
+	void ProcessSector(int streamID, uint8_t* buff, const SectorSource& source, int32_t start_time, int32_t end_time, const QString& debug);
 	void Reset();
 	void SetBoundary(uint32_t start_timecode, uint32_t duration, const CellListElem *cell);
 
@@ -514,9 +668,38 @@ public:
 		return m_strings[streamID];
 	}
 
+	Writer * GetWriter(uint8_t streamID) const {
+		return m_muxers[streamID];
+	}
+
+	void Flush();
+	QStringList GetOutputFiles() const;
+
+	// the streams with a track in the muxer are written to it instead of the writers,
+	// Reset() forgets the muxer
+	void SetMatroskaMuxer(MatroskaMuxer * muxer) {
+		m_matroska = muxer;
+	}
+
+	MatroskaMuxer * GetMatroskaMuxer() const {
+		return m_matroska;
+	}
+
+	// statistics of the processed packets, kept across Reset()
+	uint32_t GetPacketCount(uint8_t streamID) const {
+		return m_packets[streamID];
+	}
+
+	uint64_t GetByteCount(uint8_t streamID) const {
+		return m_bytes[streamID];
+	}
+
 protected:
 	Writer * m_muxers[256];
 	QString m_strings[256];
+	uint32_t m_packets[256];
+	uint64_t m_bytes[256];
+	MatroskaMuxer * m_matroska;
 };
 
 // ----------------------------------------------------------------------------
@@ -554,27 +737,89 @@ class CellsListType;
 class VobParser
 {
 public:
-	VobParser(const char* dirname, int16_t title, bool menu);
+	// with the IFOFile of the disc, the files it already located are not searched again
+	VobParser(const char* dirname, int16_t title, bool menu, const IFOFile *ifo = NULL);
 	void Reset();
 	bool ParseNextPacket(const CellsListType & Cells);
+	// only the sectors of the plan are parsed, an empty plan reads the whole file
+	void SetReadPlan(const ReadPlan & plan)
+	{
+		m_plan = plan;
+		m_planIndex = 0;
+	}
+	// with a single angle, the interleaved units of the other angles of the
+	// angle blocks are jumped over, the cells of the angle are the selected ones
+	void SetSingleAngle(bool enabled)
+	{
+		m_singleAngle = enabled;
+	}
+	// with resync, the unreadable sectors and the ones that do not start with a
+	// pack header are skipped up to the next pack start instead of ending the pass.
+	// The errors of the outputs still end it.
+	void SetResync(bool enabled)
+	{
+		m_resync = enabled;
+	}
+	bool Resume(uint32_t sector, uint32_t timecodeOffset);
+	// Parse the navigation pack at the current sector, then go to the one of the
+	// next VOBU with the DSI end address without reading the VOBU itself.
+	// Returns the sector of the navigation pack, -1 at the end of the file.
+	int64_t ParseNextVOBU();
 	uint32_t GetPacketCount() const;
+	// sectors of the read plan (of the whole file without one) before the given sector
+	uint32_t GetPlannedSectors(uint32_t end = UINT32_MAX) const;
 	uint32_t GetPacketIndex() const;
 	char* GetCurrentPacketData() const;
-	inline uint8_t GetVobID() const;
-	inline uint8_t GetCellID() const;
+	inline uint8_t GetVobID() const
+	{
+		return m_dsi.vobu_vob_idn;
+	}
+	inline uint8_t GetCellID() const
+	{
+		return m_dsi.vobu_c_idn;
+	}
+	// true when the last parsed packet started a cell listed in the IFO
+	inline bool IsCellStart() const
+	{
+		return m_bCellStart;
+	}
+	inline uint32_t GetTimecodeOffset() const
+	{
+		return m_pci_vob_timecode_offset;
+	}
 	bool IsNewCell();
 	virtual ~VobParser();
 	inline CompositeDemuxWriter & GetDemuxer()
 	{
 		return m_demuxer;
 	}
+	inline const CompositeDemuxWriter & GetDemuxer() const
+	{
+		return m_demuxer;
+	}
+	// number of sectors read from the disc and time spent reading them in ns
+	inline uint32_t GetSectorsRead() const
+	{
+		return m_sectorsRead;
+	}
+	inline uint64_t GetReadTime() const
+	{
+		return m_readTime;
+	}
 	uint32_t GetCellSCR() const;
+	// damaged ranges skipped in resync mode, both ends included
+	inline const std::vector<SectorExtent> & GetSkippedSectors() const
+	{
+		return m_skipped;
+	}
 
 	nav_dsi_gi m_dsi;
 	nav_pci_gi m_pci;
 	packet_info pktinfo;
 	PES_header_data_content pes_header_data_content;
 protected:
+	void ParsePackHeader();
+	void ParseSystemHeader();
 	void ParseNavPacket();
 	void ParseAudioPacket(int StreamID);
 	void ParseVideoPacket();
@@ -583,6 +828,7 @@ protected:
 	void ParseSCR();
 	void ParsePCI();
 	void ParseDSI();
+	void UpdateInterleavedUnit();
 	void ParsePESHeaderDataContentFlag();
 	void ParsePESHeaderData();
 	uint64_t ParsePTS_DTS();
@@ -590,6 +836,13 @@ protected:
 	// Buffer management
 	bool AvailablePacketData() const;
 	bool GetNextPacket();
+	bool GetNextPack();
+	bool ReadSectorWithRetries();
+	uint32_t FindNextPackStart(uint32_t sector, uint32_t limit);
+	bool GoToPlannedSector();
+	uint32_t GetResyncLimit() const;
+	void AddSkippedSectors(uint32_t first, uint32_t last);
+	SectorSource GetSectorSource() const;
 	uint32_t GetNext32Bits();
 	uint16_t GetNext16Bits();
 	uint8_t GetNext8Bits();
@@ -605,14 +858,32 @@ private:
 	uint32_t m_pktindex;
 	uint32_t m_pktcount;
 	bool m_bFirstPacket;
+	bool m_bCellStart;
 	int64_t m_startpts;
 	int64_t m_startdts;
 	uint16_t m_pci_position;
 	uint16_t m_pci_size;
 	uint32_t m_pci_vob_timecode_offset;
+	uint32_t m_sectorsRead;
+	uint64_t m_readTime;
+	QElapsedTimer m_readTimer;
 	
 	CompositeDemuxWriter m_demuxer;
 
+	ReadPlan m_plan;
+	size_t m_planIndex;
+
+	bool m_singleAngle;
+	uint32_t m_ilvuEnd;			// last sector of the current interleaved unit
+	uint32_t m_ilvuNext;		// first sector of the next one of the same angle, 0 for none
+
+	bool m_resync;
+	std::vector<SectorExtent> m_skipped;
+
+	static const int READ_RETRIES = 4;
+	static const int RETRY_DELAY = 10;			// ms before the first retry, doubled each time
+	static const int RESYNC_BATCH = 32;			// sectors read at once to look for a pack start
+
 	int previous_vobid, previous_cellid;
 };
 
@@ -0,0 +1,148 @@
+#include "xmlwriter.h"
+
+#include <QIODevice>
+
+XmlWriter::XmlWriter(QIODevice *device, unsigned indent)
+	: device_(device), indent_(indent), startTagOpen_(false), failed_(false)
+{
+	// keep the allocation between flushes
+	buffer_.reserve(BUFFER_SIZE);
+}
+
+XmlWriter::~XmlWriter()
+{
+	flush();
+}
+
+void XmlWriter::writeStartDocument(const QString& docType, const QString& systemId)
+{
+	write("<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n");
+
+	// QDom prefers single quotes around the system identifier
+	const QChar quote = systemId.contains('\'') ? '"' : '\'';
+	write("<!DOCTYPE " + docType + " SYSTEM " + quote + systemId + quote + ">\n");
+}
+
+bool XmlWriter::writeEndDocument()
+{
+	while (!elements_.empty())
+		writeEndElement();
+
+	return flush() && !failed_;
+}
+
+void XmlWriter::writeStartElement(const QString& name)
+{
+	closeStartTag();
+	writeIndent();
+	write('<' + name);
+
+	elements_.push_back(name);
+	startTagOpen_ = true;
+}
+
+void XmlWriter::writeEndElement()
+{
+	if (elements_.empty())
+		return;
+
+	const QString name = elements_.back();
+	elements_.pop_back();
+
+	if (startTagOpen_)
+	{
+		// element without any child
+		write("/>\n");
+		startTagOpen_ = false;
+		return;
+	}
+
+	writeIndent();
+	write("</" + name + ">\n");
+}
+
+void XmlWriter::writeTextElement(const QString& name, const QString& text)
+{
+	closeStartTag();
+	writeIndent();
+	write('<' + name + '>' + escape(text, false) + "</" + name + ">\n");
+}
+
+void XmlWriter::writeTextElement(const QString& name, const QString& text, const QString& attribute, const QString& value)
+{
+	closeStartTag();
+	writeIndent();
+	write('<' + name + ' ' + attribute + "=\"" + escape(value, true) + "\">" + escape(text, false) + "</" + name + ">\n");
+}
+
+void XmlWriter::writeComment(const QString& text)
+{
+	closeStartTag();
+	writeIndent();
+
+	// a comment must not end with "--->"
+	write("<!--" + text + (text.endsWith('-') ? " -->\n\n" : "-->\n\n"));
+}
+
+void XmlWriter::closeStartTag()
+{
+	if (startTagOpen_)
+	{
+		write(">\n");
+		startTagOpen_ = false;
+	}
+}
+
+void XmlWriter::writeIndent()
+{
+	buffer_.append(QByteArray(int(elements_.size() * indent_), ' '));
+}
+
+void XmlWriter::write(const QString& text)
+{
+	buffer_.append(text.toUtf8());
+
+	if (buffer_.size() >= BUFFER_SIZE)
+		flush();
+}
+
+bool XmlWriter::flush()
+{
+	if (buffer_.isEmpty())
+		return true;
+
+	if (device_->write(buffer_) != buffer_.size())
+		failed_ = true;
+
+	buffer_.resize(0);
+	return !failed_;
+}
+
+// Same escaping as QDom: text content keeps its quotes, attribute values normalize white spaces
+QString XmlWriter::escape(const QString& text, bool attribute)
+{
+	QString result;
+	result.reserve(text.size());
+
+	for (int i = 0; i < text.size(); ++i)
+	{
+		const QChar c = text.at(i);
+
+		if (c == '<')
+			result += "&lt;";
+		else if (c == '&')
+			result += "&amp;";
+		else if (c == '>' && i >= 2 && text.at(i - 1) == ']' && text.at(i - 2) == ']')
+			result += "&gt;";
+		else if (attribute && c == '"')
+			result += "&quot;";
+		else if (attribute && (c == '\n' || c == '\t'))
+			result += QString("&#x%1;").arg(c.unicode(), 0, 16);
+		else if (c == '\r')
+			result += "&#xd;";
+		else
+			result += c;
+	}
+
+	return result;
+}
@@ -0,0 +1,52 @@
+#ifndef XML_WRITER_H
+#define XML_WRITER_H
+
+#include <vector>
+#include <QString>
+#include <QByteArray>
+#include "documentwriter.h"
+
+class QIODevice;
+
+// Writes an XML document to a device as it is generated, with the same layout
+// as QDomDocument::toString(indent) so the chapter files do not change
+class XmlWriter : public DocumentWriter
+{
+public:
+	XmlWriter(QIODevice *device, unsigned indent);
+	~XmlWriter();
+
+	// XML declaration and document type
+	void writeStartDocument(const QString& docType, const QString& systemId);
+	// close the open elements and write what is left in the buffer
+	bool writeEndDocument();
+
+	void writeStartElement(const QString& name);
+	void writeEndElement();
+
+	// element with a text content only, optionally with one attribute
+	void writeTextElement(const QString& name, const QString& text);
+	void writeTextElement(const QString& name, const QString& text, const QString& attribute, const QString& value);
+
+	// comments are followed by an empty line, like the chapter files always had
+	void writeComment(const QString& text);
+
+	static const int BUFFER_SIZE = 64 * 1024;
+
+private:
+	void closeStartTag();
+	void writeIndent();
+	void write(const QString& text);
+	bool flush();
+
+	static QString escape(const QString& text, bool attribute);
+
+	QIODevice *device_;
+	unsigned indent_;
+	QByteArray buffer_;
+	std::vector<QString> elements_;
+	bool startTagOpen_;
+	bool failed_;
+};
+
+#endif // XML_WRITER_H
@@ -10,8 +10,20 @@ DMXConsole::~DMXConsole()
 DMXConsole::DMXConsole(char *arguments[], int argumentCount)
 {
 	ready_ = true;
+	resume_ = false;
+	skipUpToDate_ = false;
+	chaptersOnly_ = false;
+	analyze_ = false;
+	ebmlChapters_ = false;
+	deterministic_ = false;
+	matroska_ = false;
+	backgroundMux_ = false;
+	linkDuplicates_ = false;
+	angle_ = 0;
+	resync_ = false;
 
-	if ((argumentCount != 7) && (argumentCount != 9))
+	// -i, -o and -t are mandatory
+	if (argumentCount < 7)
 	{
 		ShowUsage();
 		ready_ = false;
@@ -37,7 +49,38 @@ DMXConsole::DMXConsole(char *arguments[], int argumentCount)
 		else if (argument == "-t")
 			toolsPath_ = arguments[++i];
 		else if (argument == "-s")
-			selectionItems_ = generateSelectionItems(QString(arguments[++i]));
+		{
+			if (!generateSelectionItems(QString(arguments[++i]), selectionItems_))
+			{
+				DMXConsole::ShowUsage();
+				ready_ = false;
+				return;
+			}
+		}
+		else if (argument == "-r")
+			resume_ = true;
+		else if (argument == "-u")
+			skipUpToDate_ = true;
+		else if (argument == "-c")
+			chaptersOnly_ = true;
+		else if (argument == "-a")
+			analyze_ = true;
+		else if (argument == "-e")
+			ebmlChapters_ = true;
+		else if (argument == "-d")
+			deterministic_ = true;
+		else if (argument == "-k")
+			matroska_ = true;
+		else if (argument == "-b")
+			backgroundMux_ = true;
+		else if (argument == "-l")
+			linkDuplicates_ = true;
+		else if (argument == "-g")
+			angle_ = QString(arguments[++i]).toUInt();
+		else if (argument == "-y")
+			resync_ = true;
+		else if (argument == "-m")
+			metricsFile_ = arguments[++i];
 		else
 		{
 			std::cout << "ERROR: Unknown option was specified" << std::endl;
@@ -46,13 +89,52 @@ DMXConsole::DMXConsole(char *arguments[], int argumentCount)
 			return;
 		}
 	}
+
+	if (!checkModes())
+	{
+		DMXConsole::ShowUsage();
+		ready_ = false;
+	}
 }
 
-DMX::SelectionType DMXConsole::generateSelectionItems(const QString& selectionString)
+bool DMXConsole::checkModes() const
+{
+	// the options that override one another in DMX::processTitle
+	const struct
+	{
+		bool first;
+		bool second;
+		const char *options;
+	} conflicts[] = {
+		{analyze_, chaptersOnly_, "-a and -c"},
+		{analyze_, matroska_, "-a and -k"},
+		{analyze_, backgroundMux_, "-a and -b"},
+		{analyze_, ebmlChapters_, "-a and -e"},
+		{chaptersOnly_, matroska_, "-c and -k"},
+		{chaptersOnly_, backgroundMux_, "-c and -b"},
+		{matroska_, backgroundMux_, "-k and -b"},
+		{matroska_, ebmlChapters_, "-k and -e"},
+		{backgroundMux_, ebmlChapters_, "-b and -e"},
+	};
+
+	for (size_t index = 0; index < sizeof(conflicts) / sizeof(conflicts[0]); ++index)
+	{
+		if (conflicts[index].first && conflicts[index].second)
+		{
+			std::cout << "ERROR: Options " << conflicts[index].options << " cannot be used together" << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool DMXConsole::generateSelectionItems(const QString& selectionString, DMX::SelectionType& selectionItems)
 {
 	QString item;
 	QStringList subItems;
-	DMX::SelectionType selectionItems;
+
+	selectionItems.clear();
 
 	// split string using ";" as delimeter into selection item string
 	QStringList items = selectionString.split(";");
@@ -62,34 +144,78 @@ DMX::SelectionType DMXConsole::generateSelectionItems(const QString& selectionSt
 	{
 		item = items.at(index);
 
-		// split subitems into smaller parts using "," as delimeter
-		subItems = item.split(",");
+		// split subitems into smaller parts using "," as delimeter, the lists
+		// between braces are kept whole
+		subItems = splitOutsideBraces(item, ',');
+
+		// now check if we have all the components, the PGCs are optional
+		if (subItems.size() != ITEM_COUNT && subItems.size() != PGCS_INDEX)
+		{
+			std::cout << "ERROR: Incorrect selection item at index " << index << std::endl;
+			return false;
+		}
+
+		DMXSelectionItem selectionItem(subItems.at(TITLE_INDEX).toInt(), 
+													subItems.at(MENU_INDEX).toInt(),
+													subItems.at(VIDEO_INDEX).toInt());
+
+		// add audio tracks
+		QStringList trackList = extractTrackNumbers(subItems.at(AUDIO_TRACKS_INDEX));
+		for (int track = 0; track < trackList.size(); ++track)
+			selectionItem.addAudioTrack(trackList.at(track).toUInt());
 
-		// now check if we have all the components
+		// add subtitle tracks
+		trackList = extractTrackNumbers(subItems.at(SUBTITLE_TRACKS_INDEX));
+		for (int track = 0; track < trackList.size(); ++track)
+			selectionItem.addSubtitleTrack(trackList.at(track).toUInt());
+
+		// add PGCs and cells
 		if (subItems.size() == ITEM_COUNT)
 		{
-			DMXSelectionItem item(subItems.at(TITLE_INDEX).toInt(), 
-														subItems.at(MENU_INDEX).toInt(),
-														subItems.at(VIDEO_INDEX).toInt());
-
-			// add audio tracks
-			int index = 0;
-			QStringList trackList = extractTrackNumbers(subItems.at(1));
-			for (index = 0; index < trackList.size(); ++index)
-				item.addAudioTrack(trackList.at(index).toUInt());
-
-			// add subtitle tracks
-			trackList = extractTrackNumbers(subItems.at(2));
-			for (index = 0; index < trackList.size(); ++index)
-				item.addSubtitleTrack(trackList.at(index).toUInt());
-
-			selectionItems.push_back(item);
+			trackList = extractTrackNumbers(subItems.at(PGCS_INDEX));
+			for (int pgc = 0; pgc < trackList.size(); ++pgc)
+			{
+				if (!addPgcSelection(selectionItem, trackList.at(pgc)))
+				{
+					std::cout << "ERROR: Incorrect PGC selection '" << qPrintable(trackList.at(pgc)) << "' at index " << index << std::endl;
+					return false;
+				}
+			}
+		}
+
+		selectionItems.push_back(selectionItem);
+	}
+
+	return true;
+}
+
+QStringList DMXConsole::splitOutsideBraces(const QString& text, QChar separator)
+{
+	QStringList parts;
+	QString part;
+	int depth = 0;
+
+	for (int index = 0; index < text.size(); ++index)
+	{
+		const QChar c = text.at(index);
+
+		if (c == '{')
+			++depth;
+		else if (c == '}' && depth > 0)
+			--depth;
+
+		if (c == separator && !depth)
+		{
+			parts << part.trimmed();
+			part.clear();
 		}
 		else
-			fprintf(stderr, "WARNING: Incorrect selection item at index %d was found\n", index);
+			part += c;
 	}
 
-	return selectionItems;
+	parts << part.trimmed();
+
+	return parts;
 }
 
 QStringList DMXConsole::extractTrackNumbers(const QString& trackNumberString)
@@ -97,7 +223,46 @@ QStringList DMXConsole::extractTrackNumbers(const QString& trackNumberString)
 	if ( trackNumberString.size() <= 2 )
 		return QStringList();
 
-	return trackNumberString.mid(1, trackNumberString.size() - 1).split(",");
+	return trackNumberString.mid(1, trackNumberString.size() - 2).split(",");
+}
+
+// [languageUnit/]pgc[:firstCell[-lastCell]], all numbers start at 1 and 0 stands for all
+bool DMXConsole::addPgcSelection(DMXSelectionItem& item, const QString& pgcString)
+{
+	bool ok = true;
+	uint16_t languageUnit = 0, firstCell = 0, lastCell = 0;
+	QString pgc = pgcString.trimmed();
+
+	const int unitEnd = pgc.indexOf('/');
+	if (unitEnd >= 0)
+	{
+		languageUnit = pgc.left(unitEnd).toUShort(&ok);
+		pgc = pgc.mid(unitEnd + 1);
+	}
+
+	const int pgcEnd = pgc.indexOf(':');
+	if (ok && pgcEnd >= 0)
+	{
+		const QStringList cells = pgc.mid(pgcEnd + 1).split("-");
+		pgc = pgc.left(pgcEnd);
+
+		firstCell = cells.at(0).toUShort(&ok);
+		lastCell = firstCell;
+		if (ok && cells.size() > 1)
+			lastCell = cells.at(1).toUShort(&ok);
+		if (cells.size() > 2 || (lastCell && lastCell < firstCell))
+			ok = false;
+	}
+
+	if (!ok)
+		return false;
+
+	const uint16_t pgcNumber = pgc.toUShort(&ok);
+	if (!ok)
+		return false;
+
+	item.addPgc(languageUnit, pgcNumber, firstCell, lastCell);
+	return true;
 }
 
 void DMXConsole::extract()
@@ -106,6 +271,18 @@ void DMXConsole::extract()
 	{
 		DMX extractor (true);
 		extractor.setExtractionParameters(sourcePath_, destinationPath_, toolsPath_, selectionItems_);
+		extractor.setResumeEnabled(resume_);
+		extractor.setSkipUpToDate(skipUpToDate_);
+		extractor.setChaptersOnly(chaptersOnly_);
+		extractor.setAnalyzeOnly(analyze_);
+		extractor.setChapterFormat(ebmlChapters_ ? ChapterManager::FORMAT_EBML : ChapterManager::FORMAT_XML);
+		extractor.setDeterministicUIDs(deterministic_);
+		extractor.setMatroskaOutput(matroska_);
+		extractor.setBackgroundMux(backgroundMux_);
+		extractor.setLinkDuplicates(linkDuplicates_);
+		extractor.setAngle(angle_);
+		extractor.setResync(resync_);
+		extractor.setMetricsFile(metricsFile_);
 		extractor.start();
 		extractor.wait();
 	}
@@ -116,6 +293,19 @@ void DMXConsole::ShowUsage()
 	std::cout << "USAGE: DvdMenuExtractor [<options>]\n\n"
 						<< " Show usage:        -h\n"
 						<< " Specify folders:   -i <dir> -o <dir> -t <dir>\n"
-						<< " Specify selection: -s title, extractMenu, extractVideo, {audioTracks}, {subTracks};..."
+						<< " Specify selection: -s title, extractMenu, extractVideo, {audioTracks}, {subTracks}[, {pgcs}];...\n"
+						<< "                    pgcs: [languageUnit/]pgc[:firstCell[-lastCell]],... (0 for all)\n"
+						<< " Resume extraction: -r\n"
+						<< " Skip done titles:  -u\n"
+						<< " Chapters only:     -c\n"
+						<< " Analyze only:      -a\n"
+						<< " Binary chapters:   -e\n"
+						<< " Reproducible UIDs: -d\n"
+						<< " Direct MKV output: -k\n"
+						<< " Background mux:    -b\n"
+						<< " Link same menus:   -l\n"
+						<< " Single angle:      -g <angle>\n"
+						<< " Skip bad sectors:  -y (unreadable sectors and broken packs, output errors still abort)\n"
+						<< " Live metrics:      -m <file>"
 						<< std::endl;
 }
@@ -15,16 +15,33 @@ public:
 
 private:
 	bool ready_;
+	bool resume_;
+	bool skipUpToDate_;
+	bool chaptersOnly_;
+	bool analyze_;
+	bool ebmlChapters_;
+	bool deterministic_;
+	bool matroska_;
+	bool backgroundMux_;
+	bool linkDuplicates_;
+	unsigned int angle_;
+	bool resync_;
 	QString toolsPath_;
 	QString sourcePath_;
 	QString destinationPath_;
+	QString metricsFile_;
 	DMX::SelectionType selectionItems_;
 
 	enum {TITLE_INDEX = 0, MENU_INDEX, VIDEO_INDEX,
-				AUDIO_TRACKS_INDEX, SUBTITLE_TRACKS_INDEX, ITEM_COUNT};
+				AUDIO_TRACKS_INDEX, SUBTITLE_TRACKS_INDEX, PGCS_INDEX, ITEM_COUNT};
 	
+	static QStringList splitOutsideBraces(const QString& text, QChar separator);
 	QStringList extractTrackNumbers(const QString& trackNumberString);
-	DMX::SelectionType generateSelectionItems(const QString& selectionString);
+	bool addPgcSelection(DMXSelectionItem& item, const QString& pgcString);
+	// false with an error message when an item is malformed
+	bool generateSelectionItems(const QString& selectionString, DMX::SelectionType& selectionItems);
+	// false with an error message when modes that exclude each other are combined
+	bool checkModes() const;
 };
 
 #endif // DMXCONSOLE_H
@@ -23,7 +23,8 @@ bool DMXSelectionTree::loadIFOFile(const QString &path)
 
 	// reset last file
 	delete ifoFile_;
-	ifoFile_ = DMX::OpenIFOFile(path);
+	// every title set is listed, load them all at once
+	ifoFile_ = DMX::OpenIFOFile(path, IFO_LOAD_PARALLEL);
 
 	if (ifoFile_ == 0)
 		return false;
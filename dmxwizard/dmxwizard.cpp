@@ -146,6 +146,7 @@ void DMXWizard::setupSlots()
 	// setup slots for extraction
 	connect(&dmx, SIGNAL(finished()), this, SLOT(extractionFinished()));
 	connect(&dmx, SIGNAL(progressChanged(int)), ui.progressBar, SLOT(setValue(int)));
+	connect(&dmx, SIGNAL(progressDetailsChanged(const QString&)), ui.progressInfoLabel, SLOT(setText(const QString&)));
 	connect(&dmx, SIGNAL(stepChanged(const QString&)), this, SLOT(extractionStepChanged(const QString&)));
 }
 